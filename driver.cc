@@ -1,30 +1,338 @@
 
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "adbc.h"
+#include "simple_csv_partition.h"
 #include "simple_csv_reader.h"
 
-// A little bit of hack, but we really do need placeholders for the private
-// data for driver/database/connection/statement even though we don't use them.
-// A real driver *would* use them, but also, the way to mark AdbcDriver and
-// friends as released is to set the private_data to nullptr. Therefore, we need
-// something that is *not* null to put there at the very least.
+// Database and statement options understood by this driver
+#define SIMPLE_CSV_OPTION_INPUT_MODE "adbc.simple_csv.input_mode"
+#define SIMPLE_CSV_OPTION_READAHEAD_BLOCKS "adbc.simple_csv.readahead_blocks"
+#define SIMPLE_CSV_OPTION_BATCH_SIZE_ROWS "adbc.simple_csv.batch_size_rows"
+#define SIMPLE_CSV_OPTION_BATCH_SIZE_BYTES "adbc.simple_csv.batch_size_bytes"
+#define SIMPLE_CSV_OPTION_LARGE_STRING "adbc.simple_csv.large_string"
+#define SIMPLE_CSV_OPTION_THREADS "adbc.simple_csv.threads"
+#define SIMPLE_CSV_OPTION_PARTITION_SIZE_BYTES "adbc.simple_csv.partition_size_bytes"
+#define SIMPLE_CSV_OPTION_INFER_TYPES "adbc.simple_csv.infer_types"
+#define SIMPLE_CSV_OPTION_INFER_ROWS "adbc.simple_csv.infer_rows"
+#define SIMPLE_CSV_OPTION_DICTIONARY "adbc.simple_csv.dictionary"
+#define SIMPLE_CSV_OPTION_DICTIONARY_MAX_VALUES "adbc.simple_csv.dictionary_max_values"
+#define SIMPLE_CSV_OPTION_COLUMN_TYPES "adbc.simple_csv.column_types"
+#define SIMPLE_CSV_OPTION_NULL_VALUES "adbc.simple_csv.null_values"
+#define SIMPLE_CSV_OPTION_COLUMNS "adbc.simple_csv.columns"
+#define SIMPLE_CSV_OPTION_LIMIT "adbc.simple_csv.limit"
+#define SIMPLE_CSV_OPTION_OFFSET "adbc.simple_csv.offset"
+#define SIMPLE_CSV_OPTION_FILTER "adbc.simple_csv.filter"
+#define SIMPLE_CSV_OPTION_COUNT_ONLY "adbc.simple_csv.count_only"
+#define SIMPLE_CSV_OPTION_CACHE_BYTES "adbc.simple_csv.cache_bytes"
+#define SIMPLE_CSV_OPTION_SIDECAR "adbc.simple_csv.sidecar"
+#define SIMPLE_CSV_OPTION_SIDECAR_DIR "adbc.simple_csv.sidecar_dir"
+#define SIMPLE_CSV_OPTION_INDEX "adbc.simple_csv.index"
+#define SIMPLE_CSV_OPTION_INDEX_INTERVAL "adbc.simple_csv.index_interval"
+#define SIMPLE_CSV_OPTION_BUILD_INDEX "adbc.simple_csv.build_index"
+
+static void SimpleCsvReleaseError(struct AdbcError* error) {
+  delete[] error->message;
+  error->message = nullptr;
+  error->release = nullptr;
+}
+
+static void SimpleCsvSetError(struct AdbcError* error, const char* fmt, ...) {
+  if (error == nullptr) {
+    return;
+  }
+
+  if (error->release != nullptr) {
+    error->release(error);
+  }
+
+  va_list args;
+  va_start(args, fmt);
+  int size = vsnprintf(nullptr, 0, fmt, args);
+  va_end(args);
+
+  error->message = new char[size + 1];
+  va_start(args, fmt);
+  vsnprintf(error->message, size + 1, fmt, args);
+  va_end(args);
+  error->release = &SimpleCsvReleaseError;
+}
+
+// Maps the errno-style codes returned by the reader to ADBC status codes
+static AdbcStatusCode SimpleCsvStatusFromCode(int code) {
+  switch (code) {
+    case NANOARROW_OK:
+      return ADBC_STATUS_OK;
+    case EINVAL:
+      return ADBC_STATUS_INVALID_ARGUMENT;
+    case ENOENT:
+      return ADBC_STATUS_NOT_FOUND;
+    case ENOTSUP:
+      return ADBC_STATUS_NOT_IMPLEMENTED;
+    default:
+      return ADBC_STATUS_IO;
+  }
+}
+
+// Parses a non-negative integer option value
+static AdbcStatusCode SimpleCsvParseCount(const char* key, const char* value,
+                                          int64_t* out, struct AdbcError* error) {
+  char* end;
+  errno = 0;
+  long long parsed = strtoll(value, &end, 10);
+  if (errno != 0 || end == value || *end != '\0' || parsed < 0) {
+    SimpleCsvSetError(error, "Invalid value for option '%s': '%s'", key, value);
+    return ADBC_STATUS_INVALID_ARGUMENT;
+  }
+
+  *out = parsed;
+  return ADBC_STATUS_OK;
+}
+
+// Parses a true/false option value
+static AdbcStatusCode SimpleCsvParseFlag(const char* key, const char* value, bool* out,
+                                         struct AdbcError* error) {
+  if (strcmp(value, "true") == 0) {
+    *out = true;
+  } else if (strcmp(value, "false") == 0) {
+    *out = false;
+  } else {
+    SimpleCsvSetError(error, "Invalid value for option '%s': '%s'", key, value);
+    return ADBC_STATUS_INVALID_ARGUMENT;
+  }
+
+  return ADBC_STATUS_OK;
+}
+
+// Splits a comma-separated option value. An empty value is an empty list.
+static std::vector<std::string> SimpleCsvSplitList(const char* value) {
+  std::vector<std::string> items;
+  std::string value_str(value);
+  if (value_str.empty()) {
+    return items;
+  }
+
+  size_t start = 0;
+  while (true) {
+    size_t end = value_str.find(',', start);
+    if (end == std::string::npos) {
+      items.push_back(value_str.substr(start));
+      return items;
+    }
+
+    items.push_back(value_str.substr(start, end - start));
+    start = end + 1;
+  }
+}
+
+// Parses a comma-separated list of name:type pairs
+static AdbcStatusCode SimpleCsvParseColumnTypes(
+    const char* key, const char* value,
+    std::vector<std::pair<std::string, SimpleCsvColumnType>>* out,
+    struct AdbcError* error) {
+  std::vector<std::pair<std::string, SimpleCsvColumnType>> column_types;
+  for (const std::string& item : SimpleCsvSplitList(value)) {
+    size_t colon = item.rfind(':');
+    SimpleCsvColumnType type;
+    if (colon == std::string::npos || colon == 0 ||
+        !SimpleCsvColumnTypeFromName(item.substr(colon + 1), &type)) {
+      SimpleCsvSetError(error, "Invalid value for option '%s': '%s'", key, value);
+      return ADBC_STATUS_INVALID_ARGUMENT;
+    }
+
+    column_types.emplace_back(item.substr(0, colon), type);
+  }
+
+  *out = std::move(column_types);
+  return ADBC_STATUS_OK;
+}
+
+// Applies a database or statement option to options
+static AdbcStatusCode SimpleCsvSetOption(SimpleCsvOptions* options, const char* key,
+                                         const char* value, struct AdbcError* error) {
+  std::string key_str(key);
+  std::string value_str(value);
+
+  if (key_str == SIMPLE_CSV_OPTION_INPUT_MODE) {
+    if (value_str == "buffered") {
+      options->input_mode = SimpleCsvInputMode::BUFFERED;
+    } else if (value_str == "mmap") {
+      options->input_mode = SimpleCsvInputMode::MMAP;
+    } else if (value_str == "readahead") {
+      options->input_mode = SimpleCsvInputMode::READAHEAD;
+    } else if (value_str == "io_uring") {
+      options->input_mode = SimpleCsvInputMode::IO_URING;
+    } else {
+      SimpleCsvSetError(error, "Invalid value for option '%s': '%s'", key, value);
+      return ADBC_STATUS_INVALID_ARGUMENT;
+    }
+    return ADBC_STATUS_OK;
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_READAHEAD_BLOCKS) {
+    // The scanner holds on to one block while it waits for the next, so one
+    // block could never be refilled
+    AdbcStatusCode status =
+        SimpleCsvParseCount(key, value, &options->readahead_blocks, error);
+    if (status == ADBC_STATUS_OK && options->readahead_blocks < 2) {
+      SimpleCsvSetError(error, "Invalid value for option '%s': '%s'", key, value);
+      return ADBC_STATUS_INVALID_ARGUMENT;
+    }
+    return status;
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_BATCH_SIZE_ROWS) {
+    return SimpleCsvParseCount(key, value, &options->batch_size_rows, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_BATCH_SIZE_BYTES) {
+    return SimpleCsvParseCount(key, value, &options->batch_size_bytes, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_LARGE_STRING) {
+    if (value_str == "auto") {
+      options->large_string = SimpleCsvLargeString::AUTO;
+    } else if (value_str == "always") {
+      options->large_string = SimpleCsvLargeString::ALWAYS;
+    } else if (value_str == "never") {
+      options->large_string = SimpleCsvLargeString::NEVER;
+    } else {
+      SimpleCsvSetError(error, "Invalid value for option '%s': '%s'", key, value);
+      return ADBC_STATUS_INVALID_ARGUMENT;
+    }
+    return ADBC_STATUS_OK;
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_THREADS) {
+    AdbcStatusCode status = SimpleCsvParseCount(key, value, &options->threads, error);
+    if (status == ADBC_STATUS_OK && options->threads == 0) {
+      SimpleCsvSetError(error, "Invalid value for option '%s': '%s'", key, value);
+      return ADBC_STATUS_INVALID_ARGUMENT;
+    }
+    return status;
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_PARTITION_SIZE_BYTES) {
+    return SimpleCsvParseCount(key, value, &options->partition_size_bytes, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_INFER_TYPES) {
+    return SimpleCsvParseFlag(key, value, &options->infer_types, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_INFER_ROWS) {
+    return SimpleCsvParseCount(key, value, &options->infer_rows, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_DICTIONARY) {
+    return SimpleCsvParseFlag(key, value, &options->dictionary, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_DICTIONARY_MAX_VALUES) {
+    return SimpleCsvParseCount(key, value, &options->dictionary_max_values, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_COLUMN_TYPES) {
+    return SimpleCsvParseColumnTypes(key, value, &options->column_types, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_NULL_VALUES) {
+    options->null_values = SimpleCsvSplitList(value);
+    return ADBC_STATUS_OK;
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_COLUMNS) {
+    options->columns = SimpleCsvSplitList(value);
+    return ADBC_STATUS_OK;
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_LIMIT) {
+    return SimpleCsvParseCount(key, value, &options->limit, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_OFFSET) {
+    return SimpleCsvParseCount(key, value, &options->offset, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_FILTER) {
+    options->filter = value_str;
+    return ADBC_STATUS_OK;
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_COUNT_ONLY) {
+    return SimpleCsvParseFlag(key, value, &options->count_only, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_CACHE_BYTES) {
+    return SimpleCsvParseCount(key, value, &options->cache_bytes, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_SIDECAR) {
+    return SimpleCsvParseFlag(key, value, &options->sidecar, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_SIDECAR_DIR) {
+    options->sidecar_dir = value_str;
+    return ADBC_STATUS_OK;
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_INDEX) {
+    return SimpleCsvParseFlag(key, value, &options->index, error);
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_INDEX_INTERVAL) {
+    AdbcStatusCode status =
+        SimpleCsvParseCount(key, value, &options->index_interval, error);
+    if (status == ADBC_STATUS_OK && options->index_interval == 0) {
+      SimpleCsvSetError(error, "Invalid value for option '%s': '%s'", key, value);
+      return ADBC_STATUS_INVALID_ARGUMENT;
+    }
+    return status;
+  }
+
+  if (key_str == SIMPLE_CSV_OPTION_BUILD_INDEX) {
+    return SimpleCsvParseFlag(key, value, &options->build_index, error);
+  }
+
+  SimpleCsvSetError(error, "Unknown option '%s'", key);
+  return ADBC_STATUS_NOT_IMPLEMENTED;
+}
+
+// The driver itself has no state, but the way to mark an AdbcDriver as released
+// is to set its private_data to nullptr, so it needs something that is *not*
+// null to put there.
 struct SimpleCsvDriverPrivate {
   int not_empty;
 };
 
+// Options set on the database are the defaults for every statement created
+// from its connections. The streams of those statements share state (e.g.,
+// an io_uring instance and the schema and batch caches) through the database.
 struct SimpleCsvDatabasePrivate {
-  int not_empty;
+  SimpleCsvOptions options;
+  std::shared_ptr<SimpleCsvSharedState> shared = std::make_shared<SimpleCsvSharedState>();
 };
 
+// A connection points at its database, whose options and shared state its
+// statements start from and whose options its partitions are read with
 struct SimpleCsvConnectionPrivate {
-  int not_empty;
+  SimpleCsvDatabasePrivate* database;
 };
 
+// A statement holds the file to read, its options (a copy of the database's
+// with the statement's own applied) and the database's shared state
 struct SimpleCsvStatementPrivate {
   std::string filename;
+  SimpleCsvOptions options;
+  std::shared_ptr<SimpleCsvSharedState> shared;
 };
 
 static AdbcStatusCode SimpleCsvDriverRelease(struct AdbcDriver* driver,
@@ -48,7 +356,9 @@ static AdbcStatusCode SimpleCsvDatabaseNew(struct AdbcDatabase* database,
 static AdbcStatusCode SimpleCsvDatabaseSetOption(struct AdbcDatabase* database,
                                                  const char* key, const char* value,
                                                  struct AdbcError* error) {
-  return ADBC_STATUS_INVALID_ARGUMENT;
+  auto database_private =
+      reinterpret_cast<SimpleCsvDatabasePrivate*>(database->private_data);
+  return SimpleCsvSetOption(&database_private->options, key, value, error);
 }
 
 static AdbcStatusCode SimpleCsvDatabaseInit(struct AdbcDatabase* database,
@@ -82,6 +392,7 @@ static AdbcStatusCode SimpleCsvConnectionInit(struct AdbcConnection* connection,
       reinterpret_cast<SimpleCsvConnectionPrivate*>(connection->private_data);
   auto database_private =
       reinterpret_cast<SimpleCsvDatabasePrivate*>(database->private_data);
+  connection_private->database = database_private;
   return ADBC_STATUS_OK;
 }
 
@@ -104,6 +415,8 @@ static AdbcStatusCode SimpleCsvStatementNew(struct AdbcConnection* connection,
   auto statement_private = new SimpleCsvStatementPrivate();
   auto connection_private =
       reinterpret_cast<SimpleCsvConnectionPrivate*>(connection->private_data);
+  statement_private->options = connection_private->database->options;
+  statement_private->shared = connection_private->database->shared;
   statement->private_data = statement_private;
   return ADBC_STATUS_OK;
 }
@@ -121,6 +434,14 @@ static AdbcStatusCode SimpleCsvStatementRelease(struct AdbcStatement* statement,
   return ADBC_STATUS_OK;
 }
 
+static AdbcStatusCode SimpleCsvStatementSetOption(struct AdbcStatement* statement,
+                                                  const char* key, const char* value,
+                                                  struct AdbcError* error) {
+  auto statement_private =
+      reinterpret_cast<SimpleCsvStatementPrivate*>(statement->private_data);
+  return SimpleCsvSetOption(&statement_private->options, key, value, error);
+}
+
 static AdbcStatusCode SimpleCsvStatementSetSqlQuery(struct AdbcStatement* statement,
                                                     const char* query,
                                                     struct AdbcError* error) {
@@ -136,8 +457,87 @@ static AdbcStatusCode SimpleCsvStatementExecuteQuery(struct AdbcStatement* state
                                                      struct AdbcError* error) {
   auto statement_private =
       reinterpret_cast<SimpleCsvStatementPrivate*>(statement->private_data);
-  InitSimpleCsvArrayStream(statement_private->filename.c_str(), out);
-  *rows_affected = -1;
+  InitSimpleCsvArrayStream(statement_private->filename.c_str(),
+                           statement_private->options, statement_private->shared,
+                           out);
+  *rows_affected = SimpleCsvIndexedRowCount(statement_private->filename.c_str(),
+                                            statement_private->options);
+  return ADBC_STATUS_OK;
+}
+
+// The serialized descriptors handed out by SimpleCsvStatementExecutePartitions()
+struct SimpleCsvPartitionsPrivate {
+  std::vector<std::string> descriptors;
+  std::vector<const uint8_t*> partitions;
+  std::vector<size_t> partition_lengths;
+};
+
+static void SimpleCsvPartitionsRelease(struct AdbcPartitions* partitions) {
+  auto partitions_private =
+      reinterpret_cast<SimpleCsvPartitionsPrivate*>(partitions->private_data);
+  delete partitions_private;
+  partitions->private_data = nullptr;
+  partitions->release = nullptr;
+}
+
+static AdbcStatusCode SimpleCsvStatementExecutePartitions(
+    struct AdbcStatement* statement, struct ArrowSchema* schema,
+    struct AdbcPartitions* partitions, int64_t* rows_affected, struct AdbcError* error) {
+  auto statement_private =
+      reinterpret_cast<SimpleCsvStatementPrivate*>(statement->private_data);
+
+  std::vector<SimpleCsvPartition> planned;
+  ArrowError arrow_error;
+  int code = SimpleCsvPlanPartitions(statement_private->filename.c_str(),
+                                     statement_private->options,
+                                     statement_private->shared, schema, &planned,
+                                     &arrow_error);
+  if (code != NANOARROW_OK) {
+    SimpleCsvSetError(error, "%s", arrow_error.message);
+    return SimpleCsvStatusFromCode(code);
+  }
+
+  auto partitions_private = new SimpleCsvPartitionsPrivate();
+  for (const SimpleCsvPartition& partition : planned) {
+    partitions_private->descriptors.push_back(partition.Serialize());
+  }
+  for (const std::string& descriptor : partitions_private->descriptors) {
+    partitions_private->partitions.push_back(
+        reinterpret_cast<const uint8_t*>(descriptor.data()));
+    partitions_private->partition_lengths.push_back(descriptor.size());
+  }
+
+  partitions->num_partitions = planned.size();
+  partitions->partitions = partitions_private->partitions.data();
+  partitions->partition_lengths = partitions_private->partition_lengths.data();
+  partitions->private_data = partitions_private;
+  partitions->release = &SimpleCsvPartitionsRelease;
+  if (rows_affected != nullptr) {
+    *rows_affected = SimpleCsvIndexedRowCount(statement_private->filename.c_str(),
+                                              statement_private->options);
+  }
+  return ADBC_STATUS_OK;
+}
+
+// Partitions are read with the options of the connection's database, except
+// for those that decide which rows and columns are returned, which come from
+// the statement that made them
+static AdbcStatusCode SimpleCsvConnectionReadPartition(
+    struct AdbcConnection* connection, const uint8_t* serialized_partition,
+    size_t serialized_length, struct ArrowArrayStream* out, struct AdbcError* error) {
+  auto connection_private =
+      reinterpret_cast<SimpleCsvConnectionPrivate*>(connection->private_data);
+
+  SimpleCsvPartition partition;
+  ArrowError arrow_error;
+  int code = partition.Deserialize(serialized_partition, serialized_length, &arrow_error);
+  if (code != NANOARROW_OK) {
+    SimpleCsvSetError(error, "%s", arrow_error.message);
+    return SimpleCsvStatusFromCode(code);
+  }
+
+  InitSimpleCsvPartitionStream(partition, connection_private->database->options,
+                               connection_private->database->shared, out);
   return ADBC_STATUS_OK;
 }
 
@@ -155,11 +555,14 @@ extern "C" AdbcStatusCode SimpleCsvDriverInit(int version, void* raw_driver,
 
   driver->ConnectionNew = SimpleCsvConnectionNew;
   driver->ConnectionInit = SimpleCsvConnectionInit;
+  driver->ConnectionReadPartition = SimpleCsvConnectionReadPartition;
   driver->ConnectionRelease = SimpleCsvConnectionRelease;
 
   driver->StatementNew = SimpleCsvStatementNew;
+  driver->StatementSetOption = SimpleCsvStatementSetOption;
   driver->StatementSetSqlQuery = SimpleCsvStatementSetSqlQuery;
   driver->StatementExecuteQuery = SimpleCsvStatementExecuteQuery;
+  driver->StatementExecutePartitions = SimpleCsvStatementExecutePartitions;
   driver->StatementRelease = SimpleCsvStatementRelease;
 
   driver->release = SimpleCsvDriverRelease;
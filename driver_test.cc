@@ -0,0 +1,873 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <utime.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <catch2/catch.hpp>
+#if defined(SIMPLE_CSV_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(SIMPLE_CSV_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+#include "adbc.h"
+#include "nanoarrow.hpp"
+#include "simple_csv_index.h"
+
+extern "C" AdbcStatusCode SimpleCsvDriverInit(int version, void* raw_driver,
+                                              struct AdbcError* error);
+
+typedef std::vector<std::pair<std::string, std::string>> SimpleCsvTestOptions;
+
+// Reads files through the driver's ADBC entry points. Files are written to
+// the working directory and removed at the end of each test.
+class SimpleCsvDriverTest {
+ public:
+  SimpleCsvDriverTest() {
+    memset(&error_, 0, sizeof(error_));
+    memset(&database_, 0, sizeof(database_));
+    memset(&connection_, 0, sizeof(connection_));
+    REQUIRE(SimpleCsvDriverInit(ADBC_VERSION_1_0_0, &driver_, &error_) ==
+            ADBC_STATUS_OK);
+    REQUIRE(driver_.DatabaseNew(&database_, &error_) == ADBC_STATUS_OK);
+    database_.private_driver = &driver_;
+    REQUIRE(driver_.DatabaseInit(&database_, &error_) == ADBC_STATUS_OK);
+    REQUIRE(driver_.ConnectionNew(&connection_, &error_) == ADBC_STATUS_OK);
+    REQUIRE(driver_.ConnectionInit(&connection_, &database_, &error_) ==
+            ADBC_STATUS_OK);
+  }
+
+  ~SimpleCsvDriverTest() {
+    driver_.ConnectionRelease(&connection_, &error_);
+    driver_.DatabaseRelease(&database_, &error_);
+    driver_.release(&driver_, &error_);
+    if (error_.release != nullptr) {
+      error_.release(&error_);
+    }
+    // In reverse, so that a directory is removed after the files in it
+    for (auto path = paths_.rbegin(); path != paths_.rend(); ++path) {
+      std::remove(path->c_str());
+    }
+  }
+
+  std::string WriteFile(const std::string& name, const std::string& contents) {
+    std::string path = "simple_csv_test_" + name;
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    output.write(contents.data(), contents.size());
+    output.close();
+    REQUIRE(output.good());
+    RemoveAfterTest(path);
+    return path;
+  }
+
+  // Removes a file the test or the driver writes (e.g., an index) at the end
+  // of the test
+  void RemoveAfterTest(const std::string& path) { paths_.push_back(path); }
+
+  // Gives path a modification time, so that a file rewritten with the same size
+  // within the resolution of the file system's clock still has a new identity
+  static void SetModificationTime(const std::string& path, time_t seconds) {
+    struct utimbuf times;
+    times.actime = seconds;
+    times.modtime = seconds;
+    REQUIRE(utime(path.c_str(), &times) == 0);
+  }
+
+  // Reads path with the given statement options, returning each row as its
+  // fields separated by '|', with null fields as <null>
+  std::vector<std::string> Read(const std::string& path,
+                                const SimpleCsvTestOptions& options = {},
+                                int64_t* rows_affected = nullptr) {
+    nanoarrow::UniqueArrayStream stream;
+    Execute(path, options, stream.get(), rows_affected);
+    return ReadStream(stream.get());
+  }
+
+  // Reads path with the given statement options, returning the length of each
+  // batch
+  std::vector<int64_t> BatchLengths(const std::string& path,
+                                    const SimpleCsvTestOptions& options) {
+    nanoarrow::UniqueArrayStream stream;
+    Execute(path, options, stream.get());
+    std::vector<int64_t> lengths;
+    while (true) {
+      nanoarrow::UniqueArray array;
+      int code = stream->get_next(stream.get(), array.get());
+      INFO(stream->get_last_error(stream.get()));
+      REQUIRE(code == NANOARROW_OK);
+      if (array->release == nullptr) {
+        return lengths;
+      }
+      lengths.push_back(array->length);
+    }
+  }
+
+  // Returns the format string of each column that reading path with the given
+  // statement options returns
+  std::vector<std::string> ColumnFormats(const std::string& path,
+                                         const SimpleCsvTestOptions& options = {}) {
+    nanoarrow::UniqueArrayStream stream;
+    Execute(path, options, stream.get());
+    nanoarrow::UniqueSchema schema;
+    INFO(stream->get_last_error(stream.get()));
+    REQUIRE(stream->get_schema(stream.get(), schema.get()) == NANOARROW_OK);
+    std::vector<std::string> formats;
+    for (int64_t i = 0; i < schema->n_children; i++) {
+      formats.push_back(schema->children[i]->format);
+    }
+    return formats;
+  }
+
+  // Reads path with the given statement options, which must fail, and returns
+  // the error message
+  std::string ReadError(const std::string& path, const SimpleCsvTestOptions& options) {
+    nanoarrow::UniqueArrayStream stream;
+    Execute(path, options, stream.get());
+    return StreamError(stream.get());
+  }
+
+  // Sets an option on a new statement, returning its status
+  AdbcStatusCode SetStatementOption(const std::string& key, const std::string& value) {
+    AdbcStatement statement;
+    memset(&statement, 0, sizeof(statement));
+    REQUIRE(driver_.StatementNew(&connection_, &statement, &error_) == ADBC_STATUS_OK);
+    std::string full_key = "adbc.simple_csv." + key;
+    AdbcStatusCode status =
+        driver_.StatementSetOption(&statement, full_key.c_str(), value.c_str(), &error_);
+    driver_.StatementRelease(&statement, &error_);
+    return status;
+  }
+
+  // Plans the partitions of path with the given statement options, returning
+  // their descriptors
+  std::vector<std::string> ExecutePartitions(const std::string& path,
+                                             const SimpleCsvTestOptions& options) {
+    AdbcStatement statement;
+    NewStatement(path, options, &statement);
+    nanoarrow::UniqueSchema schema;
+    AdbcPartitions partitions;
+    memset(&partitions, 0, sizeof(partitions));
+    AdbcStatusCode status = driver_.StatementExecutePartitions(
+        &statement, schema.get(), &partitions, nullptr, &error_);
+    driver_.StatementRelease(&statement, &error_);
+    INFO((error_.message != nullptr ? error_.message : ""));
+    REQUIRE(status == ADBC_STATUS_OK);
+
+    std::vector<std::string> descriptors;
+    for (size_t i = 0; i < partitions.num_partitions; i++) {
+      descriptors.emplace_back(reinterpret_cast<const char*>(partitions.partitions[i]),
+                               partitions.partition_lengths[i]);
+    }
+    partitions.release(&partitions);
+    return descriptors;
+  }
+
+  // Reads a partition on the test's connection, returning its rows like Read()
+  std::vector<std::string> ReadPartition(const std::string& partition) {
+    nanoarrow::UniqueArrayStream stream;
+    OpenPartition(partition, stream.get());
+    return ReadStream(stream.get());
+  }
+
+  // Reads a partition, which must fail, and returns the error message
+  std::string ReadPartitionError(const std::string& partition) {
+    nanoarrow::UniqueArrayStream stream;
+    OpenPartition(partition, stream.get());
+    return StreamError(stream.get());
+  }
+
+ private:
+  AdbcDriver driver_;
+  AdbcDatabase database_;
+  AdbcConnection connection_;
+  AdbcError error_;
+  std::vector<std::string> paths_;
+
+  // Creates a statement that reads path with the given options
+  void NewStatement(const std::string& path, const SimpleCsvTestOptions& options,
+                    AdbcStatement* statement) {
+    memset(statement, 0, sizeof(AdbcStatement));
+    REQUIRE(driver_.StatementNew(&connection_, statement, &error_) == ADBC_STATUS_OK);
+    for (const auto& option : options) {
+      std::string key = "adbc.simple_csv." + option.first;
+      INFO(key << "=" << option.second);
+      REQUIRE(driver_.StatementSetOption(statement, key.c_str(), option.second.c_str(),
+                                         &error_) == ADBC_STATUS_OK);
+    }
+    REQUIRE(driver_.StatementSetSqlQuery(statement, path.c_str(), &error_) ==
+            ADBC_STATUS_OK);
+  }
+
+  void Execute(const std::string& path, const SimpleCsvTestOptions& options,
+               ArrowArrayStream* out, int64_t* rows_affected = nullptr) {
+    AdbcStatement statement;
+    NewStatement(path, options, &statement);
+    int64_t affected = -1;
+    AdbcStatusCode status =
+        driver_.StatementExecuteQuery(&statement, out, &affected, &error_);
+    driver_.StatementRelease(&statement, &error_);
+    INFO((error_.message != nullptr ? error_.message : ""));
+    REQUIRE(status == ADBC_STATUS_OK);
+    if (rows_affected != nullptr) {
+      *rows_affected = affected;
+    }
+  }
+
+  void OpenPartition(const std::string& partition, ArrowArrayStream* out) {
+    AdbcStatusCode status = driver_.ConnectionReadPartition(
+        &connection_, reinterpret_cast<const uint8_t*>(partition.data()),
+        partition.size(), out, &error_);
+    INFO((error_.message != nullptr ? error_.message : ""));
+    REQUIRE(status == ADBC_STATUS_OK);
+  }
+
+  static std::string FormatValue(ArrowArrayView* view, int64_t i) {
+    if (ArrowArrayViewIsNull(view, i)) {
+      return "<null>";
+    }
+
+    switch (view->storage_type) {
+      case NANOARROW_TYPE_STRING:
+      case NANOARROW_TYPE_LARGE_STRING:
+      {
+        ArrowStringView value = ArrowArrayViewGetStringUnsafe(view, i);
+        return std::string(value.data, value.size_bytes);
+      }
+      case NANOARROW_TYPE_DOUBLE:
+        return std::to_string(ArrowArrayViewGetDoubleUnsafe(view, i));
+      default:
+        if (view->dictionary != nullptr) {
+          return FormatValue(view->dictionary, ArrowArrayViewGetIntUnsafe(view, i));
+        }
+        return std::to_string(ArrowArrayViewGetIntUnsafe(view, i));
+    }
+  }
+
+  static std::vector<std::string> ReadStream(ArrowArrayStream* stream) {
+    nanoarrow::UniqueSchema schema;
+    INFO(stream->get_last_error(stream));
+    REQUIRE(stream->get_schema(stream, schema.get()) == NANOARROW_OK);
+
+    std::vector<std::string> rows;
+    while (true) {
+      nanoarrow::UniqueArray array;
+      int code = stream->get_next(stream, array.get());
+      INFO(stream->get_last_error(stream));
+      REQUIRE(code == NANOARROW_OK);
+      if (array->release == nullptr) {
+        return rows;
+      }
+
+      nanoarrow::UniqueArrayView view;
+      ArrowError error;
+      REQUIRE(ArrowArrayViewInitFromSchema(view.get(), schema.get(), &error) ==
+              NANOARROW_OK);
+      REQUIRE(ArrowArrayViewSetArray(view.get(), array.get(), &error) == NANOARROW_OK);
+      for (int64_t i = 0; i < array->length; i++) {
+        std::string row;
+        for (int64_t j = 0; j < view->n_children; j++) {
+          row += (j > 0 ? "|" : "") + FormatValue(view->children[j], i);
+        }
+        rows.push_back(row);
+      }
+    }
+  }
+
+  // Reads a stream until it fails, returning the error message
+  static std::string StreamError(ArrowArrayStream* stream) {
+    nanoarrow::UniqueSchema schema;
+    int code = stream->get_schema(stream, schema.get());
+    while (code == NANOARROW_OK) {
+      nanoarrow::UniqueArray array;
+      code = stream->get_next(stream, array.get());
+      REQUIRE((code != NANOARROW_OK || array->release != nullptr));
+    }
+    return stream->get_last_error(stream);
+  }
+};
+
+// Row i of SimpleCsvTestRows(), with its fields separated by separator
+static std::string SimpleCsvTestRow(int64_t i, char separator) {
+  return std::to_string(i) + separator + "name" + std::to_string(i % 1000) + separator +
+         std::to_string(i * 0.25);
+}
+
+// A file of n_rows rows that spans several 1 MiB input blocks
+static std::string SimpleCsvTestRows(int64_t n_rows) {
+  std::string contents = "id,name,value\n";
+  for (int64_t i = 0; i < n_rows; i++) {
+    contents += SimpleCsvTestRow(i, ',') + "\n";
+  }
+  return contents;
+}
+
+// The names of the files in a directory
+static std::vector<std::string> SimpleCsvTestListDirectory(const std::string& path) {
+  std::vector<std::string> names;
+  DIR* dir = opendir(path.c_str());
+  REQUIRE(dir != nullptr);
+  while (struct dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name != "." && name != "..") {
+      names.push_back(name);
+    }
+  }
+  closedir(dir);
+  return names;
+}
+
+static ino_t SimpleCsvTestInode(const std::string& path) {
+  struct stat info;
+  REQUIRE(stat(path.c_str(), &info) == 0);
+  return info.st_ino;
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Rows that span blocks are read whole",
+                 "[scanner]") {
+  std::string path = WriteFile("rows.csv", SimpleCsvTestRows(200000));
+  std::vector<std::string> rows = Read(path);
+  REQUIRE(rows.size() == 200000);
+  for (int64_t i = 0; i < 200000; i++) {
+    if (rows[i] != SimpleCsvTestRow(i, '|')) {
+      FAIL("row " << i << ": " << rows[i]);
+    }
+  }
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Lines longer than a block are read whole",
+                 "[scanner]") {
+  std::string long_field(3 * 1024 * 1024, 'x');
+  std::string path =
+      WriteFile("long.csv", "a,b\n1," + long_field + "\n" + long_field + ",2\n3,4");
+  std::vector<std::string> expected = {"1|" + long_field, long_field + "|2", "3|4"};
+  CHECK(Read(path) == expected);
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Every input mode returns the same rows",
+                 "[input]") {
+  std::string path = WriteFile("modes.csv", SimpleCsvTestRows(200000));
+  std::vector<std::string> expected = Read(path, {{"input_mode", "buffered"}});
+  REQUIRE(expected.size() == 200000);
+  CHECK(Read(path, {{"input_mode", "mmap"}}) == expected);
+
+  for (const char* mode : {"readahead", "io_uring"}) {
+    for (const char* blocks : {"2", "3", "4"}) {
+      INFO(mode << " with " << blocks << " blocks");
+      CHECK(Read(path, {{"input_mode", mode}, {"readahead_blocks", blocks}}) ==
+            expected);
+    }
+  }
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Quoted fields are unquoted", "[quotes]") {
+  std::string path = WriteFile("quoted.csv",
+                               "a,b,c\n"
+                               "\"x,y\",\"line\nbreak\",\"say \"\"hi\"\"\"\n"
+                               "\"\",plain,\"\"\"\"\n"
+                               "\"crlf\"\"\",\"\r\n\",z\r\n"
+                               "1,\"2\",3\n");
+  // A quoted empty field is an empty string
+  std::vector<std::string> expected = {"x,y|line\nbreak|say \"hi\"", "|plain|\"",
+                                       "crlf\"|\r\n|z", "1|2|3"};
+  CHECK(Read(path) == expected);
+}
+
+// Quoted fields whose quotes, delimiters and newlines fall at every position
+// of the 64-byte chunks that the scanner classifies, and one quoted field
+// longer than a block
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Quoted fields span chunks and blocks",
+                 "[quotes]") {
+  std::string contents = "key,value,tail\n";
+  std::vector<std::string> expected;
+  for (int i = 0; i < 200; i++) {
+    std::string padding(i % 67, 'v');
+    std::string suffix(i % 5, 'w');
+    contents += std::to_string(i) + ",\"" + padding + ",\n\"\"" + suffix + "\",t\n";
+    expected.push_back(std::to_string(i) + "|" + padding + ",\n\"" + suffix + "|t");
+  }
+
+  std::string big;
+  for (int i = 0; i < 150000; i++) {
+    big += "0123456,\n";
+  }
+  contents += "big,\"" + big + "\",t\n";
+  expected.push_back("big|" + big + "|t");
+  contents += "last,\"\",t\n";
+  expected.push_back("last||t");
+
+  std::string path = WriteFile("chunks.csv", contents);
+  for (const char* mode : {"buffered", "mmap", "readahead", "io_uring"}) {
+    INFO(mode);
+    CHECK(Read(path, {{"input_mode", mode}}) == expected);
+  }
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Batches are bounded in rows and bytes",
+                 "[batches]") {
+  std::string path = WriteFile("batches.csv", SimpleCsvTestRows(10000));
+  CHECK(BatchLengths(path, {{"batch_size_rows", "1000"}}) ==
+        std::vector<int64_t>(10, 1000));
+  CHECK(BatchLengths(path, {{"batch_size_rows", "0"}, {"batch_size_bytes", "0"}}) ==
+        std::vector<int64_t>{10000});
+
+  std::vector<int64_t> lengths =
+      BatchLengths(path, {{"batch_size_rows", "0"}, {"batch_size_bytes", "16384"}});
+  CHECK(lengths.size() > 10);
+  CHECK(std::accumulate(lengths.begin(), lengths.end(), int64_t(0)) == 10000);
+  CHECK(Read(path, {{"batch_size_rows", "7"}}) == Read(path));
+}
+
+// Chunks start in the middle of quoted fields that hold newlines, which the
+// chunk's parser must not mistake for the end of a row
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Parallel reads return the rows in file order",
+                 "[threads]") {
+  std::string contents = "id,text\n";
+  std::vector<std::string> expected;
+  for (int i = 0; i < 300000; i++) {
+    std::string text = "row " + std::to_string(i) + "\nsplit, over \"\"two\"\" lines";
+    contents += std::to_string(i) + ",\"" + text + "\"\n";
+    expected.push_back(std::to_string(i) + "|row " + std::to_string(i) +
+                       "\nsplit, over \"two\" lines");
+  }
+  std::string path = WriteFile("threads.csv", contents);
+
+  for (const char* threads : {"1", "2", "3", "8"}) {
+    INFO(threads << " threads");
+    CHECK(Read(path, {{"threads", threads}}) == expected);
+  }
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Read-ahead needs at least two blocks",
+                 "[input]") {
+  CHECK(SetStatementOption("readahead_blocks", "0") == ADBC_STATUS_INVALID_ARGUMENT);
+  CHECK(SetStatementOption("readahead_blocks", "1") == ADBC_STATUS_INVALID_ARGUMENT);
+  CHECK(SetStatementOption("readahead_blocks", "2") == ADBC_STATUS_OK);
+
+  std::string path = WriteFile("readahead.csv", SimpleCsvTestRows(400000));
+  CHECK(Read(path, {{"input_mode", "readahead"}, {"readahead_blocks", "2"}}).size() ==
+        400000);
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Column types are guessed from sampled rows",
+                 "[types]") {
+  std::string path = WriteFile("types.csv",
+                               "i,d,b,day,time,s\n"
+                               "1,1.5,true,2020-01-01,2020-01-01T12:30:00,x\n"
+                               "-2,2,false,1970-01-02,1970-01-01 00:00:01,3\n");
+  CHECK(ColumnFormats(path) ==
+        std::vector<std::string>{"l", "g", "b", "tdD", "tsu:", "u"});
+  std::vector<std::string> expected = {"1|1.500000|1|18262|1577881800000000|x",
+                                       "-2|2.000000|0|1|1000000|3"};
+  CHECK(Read(path) == expected);
+
+  CHECK(ColumnFormats(path, {{"infer_types", "false"}}) ==
+        std::vector<std::string>(6, "u"));
+  CHECK(ColumnFormats(path, {{"column_types", "i:double,d:string,s:string"}}) ==
+        std::vector<std::string>{"g", "u", "b", "tdD", "tsu:", "u"});
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest,
+                 "A value that doesn't fit the guessed type is an error", "[types]") {
+  std::string path = WriteFile("late.csv", "n,s\n1,a\n2,b\nthree,c\n");
+  CHECK(Read(path, {{"infer_rows", "3"}}) ==
+        std::vector<std::string>{"1|a", "2|b", "three|c"});
+  std::string message = ReadError(path, {{"infer_rows", "2"}});
+  INFO(message);
+  CHECK(message.find("three") != std::string::npos);
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Null tokens are read as nulls", "[nulls]") {
+  std::string path = WriteFile("nulls.csv", "n,s\n1,a\n,NA\nNULL,\"NA\"\n\\N,\n");
+  // Quoted values are never null
+  CHECK(Read(path) ==
+        std::vector<std::string>{"1|a", "<null>|<null>", "<null>|NA", "<null>|<null>"});
+  CHECK(ColumnFormats(path) == std::vector<std::string>{"l", "u"});
+  CHECK(Read(path, {{"null_values", ""}}) ==
+        std::vector<std::string>{"1|a", "|NA", "NULL|NA", "\\N|"});
+  CHECK(Read(path, {{"null_values", "a,NULL"}}) ==
+        std::vector<std::string>{"1|<null>", "|NA", "<null>|NA", "\\N|"});
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Only the requested columns are returned",
+                 "[columns]") {
+  std::string path = WriteFile("columns.csv", "a,b,c\n1,\"x,y\",3\n4,5,6\n");
+  CHECK(Read(path, {{"columns", "c,a"}}) == std::vector<std::string>{"3|1", "6|4"});
+  CHECK(Read(path, {{"columns", "b"}}) == std::vector<std::string>{"x,y", "5"});
+  CHECK(ColumnFormats(path, {{"columns", "c,b"}}) == std::vector<std::string>{"l", "u"});
+  std::string message = ReadError(path, {{"columns", "a,d"}});
+  INFO(message);
+  CHECK(message.find("'d'") != std::string::npos);
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Limit and offset choose the rows returned",
+                 "[limit]") {
+  std::string path = WriteFile("limit.csv", SimpleCsvTestRows(200000));
+  std::vector<std::string> expected;
+  for (int64_t i = 150000; i < 150010; i++) {
+    expected.push_back(SimpleCsvTestRow(i, '|'));
+  }
+  CHECK(Read(path, {{"offset", "150000"}, {"limit", "10"}}) == expected);
+  CHECK(Read(path, {{"limit", "3"}}).size() == 3);
+  CHECK(Read(path, {{"limit", "0"}}).empty());
+  CHECK(Read(path, {{"offset", "199999"}}) ==
+        std::vector<std::string>{SimpleCsvTestRow(199999, '|')});
+  CHECK(Read(path, {{"offset", "200000"}}).empty());
+}
+
+// Lines that are empty (but for a carriage return) are skipped, while a line
+// that only holds a quoted empty field is a row with an empty string. Reads,
+// offsets, counts and the index must all agree on which lines are rows.
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Blank lines are skipped consistently",
+                 "[blank]") {
+  const char* contents =
+      GENERATE("x\na\n\"\"\nb\n\nc\n", "x\r\na\r\n\"\"\r\nb\r\n\r\nc",
+               "x\n\na\n\"\"\n\r\nb\n\nc\n\n");
+  std::string path = WriteFile("blank.csv", contents);
+  RemoveAfterTest(SimpleCsvIndexPath(path, ""));
+  const std::vector<std::string> rows = {"a", "", "b", "c"};
+
+  CHECK(Read(path, {{"infer_types", "false"}}) == rows);
+  CHECK(Read(path, {{"count_only", "true"}}) == std::vector<std::string>{"4"});
+  for (int64_t offset = 0; offset <= 5; offset++) {
+    INFO("offset " << offset);
+    std::vector<std::string> expected(rows.begin() + std::min<int64_t>(offset, 4),
+                                      rows.end());
+    CHECK(Read(path, {{"infer_types", "false"}, {"offset", std::to_string(offset)}}) ==
+          expected);
+  }
+
+  // Build the index from a full read, then by scanning the file
+  for (const char* build : {"index", "build_index"}) {
+    INFO(build);
+    std::remove(SimpleCsvIndexPath(path, "").c_str());
+    Read(path, {{build, "true"}, {"index_interval", "1"}});
+
+    CHECK(Read(path, {{"index", "true"}, {"count_only", "true"}}) ==
+          std::vector<std::string>{"4"});
+    int64_t rows_affected;
+    CHECK(Read(path, {{"infer_types", "false"}, {"index", "true"}}, &rows_affected) ==
+          rows);
+    CHECK(rows_affected == 4);
+    for (int64_t offset = 0; offset <= 5; offset++) {
+      INFO("offset " << offset);
+      std::vector<std::string> expected(rows.begin() + std::min<int64_t>(offset, 4),
+                                        rows.end());
+      CHECK(Read(path, {{"infer_types", "false"},
+                        {"index", "true"},
+                        {"offset", std::to_string(offset)}}) == expected);
+    }
+  }
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Filters return the rows that match",
+                 "[filter]") {
+  std::string path = WriteFile("filter.csv",
+                               "country,amount,\"order date\"\n"
+                               "NZ,100,2020-01-01\n"
+                               "AU,50,2019-06-30\n"
+                               "NZ,20,2019-12-31\n"
+                               ",150,\n");
+  CHECK(Read(path,
+             {{"filter",
+               "country = 'NZ' AND (amount >= 100 OR \"order date\" < 2020-01-01)"}}) ==
+        std::vector<std::string>{"NZ|100|18262", "NZ|20|18261"});
+  // A comparison with a null is false
+  CHECK(Read(path, {{"filter", "amount > 60"}}) ==
+        std::vector<std::string>{"NZ|100|18262", "<null>|150|<null>"});
+  CHECK(Read(path, {{"filter", "country <> 'NZ'"}}) ==
+        std::vector<std::string>{"AU|50|18077"});
+  CHECK(Read(path, {{"filter", "country = 'NZ'"}, {"offset", "1"}}) ==
+        std::vector<std::string>{"NZ|20|18261"});
+
+  std::string message = ReadError(path, {{"filter", "amount >"}});
+  CHECK_FALSE(message.empty());
+}
+
+// Rows are filtered a group at a time, so a filter on a file of several
+// groups and batches must still return exactly the rows that match
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Filters match rows across groups and batches",
+                 "[filter]") {
+  std::string path = WriteFile("filter_rows.csv", SimpleCsvTestRows(100000));
+  std::vector<std::string> expected;
+  for (int64_t i = 0; i < 100000; i++) {
+    if (i >= 99990 || i % 1000 == 7) {
+      expected.push_back(SimpleCsvTestRow(i, '|'));
+    }
+  }
+  CHECK(Read(path, {{"filter", "id >= 99990 OR name = 'name7'"},
+                    {"batch_size_rows", "64"}}) == expected);
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "count_only counts the rows of a read",
+                 "[count]") {
+  std::string path = WriteFile("count.csv", SimpleCsvTestRows(200000));
+  CHECK(ColumnFormats(path, {{"count_only", "true"}}) == std::vector<std::string>{"l"});
+  for (const char* mode : {"buffered", "mmap", "readahead", "io_uring"}) {
+    INFO(mode);
+    CHECK(Read(path, {{"count_only", "true"}, {"input_mode", mode}}) ==
+          std::vector<std::string>{"200000"});
+  }
+  CHECK(Read(path, {{"count_only", "true"}, {"offset", "199990"}}) ==
+        std::vector<std::string>{"10"});
+  CHECK(Read(path, {{"count_only", "true"}, {"limit", "5"}}) ==
+        std::vector<std::string>{"5"});
+  CHECK(Read(path, {{"count_only", "true"}, {"filter", "name = 'name7'"}}) ==
+        std::vector<std::string>{"200"});
+
+  // Newlines in quoted fields don't end rows
+  path = WriteFile("count_quoted.csv", "a,b\n\"x\ny\",1\n\"\n\n\",2\nz,3\n");
+  CHECK(Read(path, {{"count_only", "true"}}) == std::vector<std::string>{"3"});
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Low-cardinality strings are dictionary-encoded",
+                 "[dictionary]") {
+  std::string path = WriteFile("dictionary.csv", "id,color\n1,red\n2,blue\n3,red\n4,\n");
+  std::vector<std::string> expected = {"1|red", "2|blue", "3|red", "4|<null>"};
+  CHECK(ColumnFormats(path, {{"dictionary", "true"}}) ==
+        std::vector<std::string>{"l", "i"});
+  CHECK(Read(path, {{"dictionary", "true"}}) == expected);
+  CHECK(ColumnFormats(path, {{"dictionary", "true"}, {"dictionary_max_values", "1"}}) ==
+        std::vector<std::string>{"l", "u"});
+  CHECK(ColumnFormats(path, {{"column_types", "color:dictionary"}}) ==
+        std::vector<std::string>{"l", "i"});
+
+  // Each batch has a dictionary of its own values
+  path = WriteFile("dictionary_batches.csv", SimpleCsvTestRows(10000));
+  CHECK(ColumnFormats(path, {{"dictionary", "true"}}) ==
+        std::vector<std::string>{"l", "i", "g"});
+  CHECK(Read(path, {{"dictionary", "true"}, {"batch_size_rows", "300"}}) == Read(path));
+}
+
+#if defined(SIMPLE_CSV_HAVE_ZLIB)
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Gzip files are decompressed", "[compression]") {
+  std::string contents = SimpleCsvTestRows(200000);
+  std::string path = "simple_csv_test_gzip.csv.gz";
+  RemoveAfterTest(path);
+  gzFile file = gzopen(path.c_str(), "wb");
+  REQUIRE(file != nullptr);
+  REQUIRE(gzwrite(file, contents.data(), static_cast<unsigned>(contents.size())) ==
+          static_cast<int>(contents.size()));
+  REQUIRE(gzclose(file) == Z_OK);
+
+  std::vector<std::string> expected = Read(WriteFile("gzip.csv", contents));
+  for (const char* mode : {"buffered", "mmap"}) {
+    INFO(mode);
+    CHECK(Read(path, {{"input_mode", mode}}) == expected);
+  }
+  // Compressed files are parsed on one thread
+  CHECK(Read(path, {{"threads", "4"}}) == expected);
+  CHECK(Read(path, {{"count_only", "true"}}) == std::vector<std::string>{"200000"});
+  CHECK(Read(path, {{"offset", "199990"}}).size() == 10);
+
+  // The positions in the index of a compressed file can't be read from, so
+  // it only gives the row count
+  RemoveAfterTest(SimpleCsvIndexPath(path, ""));
+  CHECK(Read(path, {{"build_index", "true"}, {"index_interval", "1000"}}) ==
+        std::vector<std::string>{"200000"});
+  int64_t rows_affected;
+  CHECK(Read(path, {{"index", "true"}, {"count_only", "true"}}, &rows_affected) ==
+        std::vector<std::string>{"200000"});
+  CHECK(rows_affected == 200000);
+  CHECK(Read(path, {{"index", "true"}, {"offset", "150500"}, {"limit", "5"}}) ==
+        std::vector<std::string>(expected.begin() + 150500, expected.begin() + 150505));
+  CHECK(Read(path, {{"index", "true"}, {"threads", "4"}}) == expected);
+  CHECK(ExecutePartitions(path, {{"index", "true"}, {"partition_size_bytes", "1000000"}})
+            .size() == 1);
+}
+#endif
+
+#if defined(SIMPLE_CSV_HAVE_ZSTD)
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Zstd files are decompressed", "[compression]") {
+  std::string contents = SimpleCsvTestRows(200000);
+  std::string compressed(ZSTD_compressBound(contents.size()), '\0');
+  size_t size = ZSTD_compress(&compressed[0], compressed.size(), contents.data(),
+                              contents.size(), 1);
+  REQUIRE(!ZSTD_isError(size));
+  compressed.resize(size);
+  std::string path = WriteFile("zstd.csv.zst", compressed);
+
+  std::vector<std::string> expected = Read(WriteFile("zstd.csv", contents));
+  CHECK(Read(path) == expected);
+  CHECK(Read(path, {{"threads", "4"}}) == expected);
+  CHECK(Read(path, {{"count_only", "true"}}) == std::vector<std::string>{"200000"});
+}
+#endif
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "large_string chooses the string type",
+                 "[strings]") {
+  std::string path = WriteFile("strings.csv", "s,n\na,1\n\"b,c\",2\n");
+  CHECK(ColumnFormats(path, {{"large_string", "always"}}) ==
+        std::vector<std::string>{"U", "l"});
+  CHECK(ColumnFormats(path, {{"large_string", "never"}}) ==
+        std::vector<std::string>{"u", "l"});
+  // A small, uncompressed file doesn't need 64-bit offsets
+  CHECK(ColumnFormats(path, {{"large_string", "auto"}, {"batch_size_bytes", "0"}}) ==
+        std::vector<std::string>{"u", "l"});
+  CHECK(Read(path, {{"large_string", "always"}}) ==
+        std::vector<std::string>{"a|1", "b,c|2"});
+  CHECK(SetStatementOption("large_string", "sometimes") == ADBC_STATUS_INVALID_ARGUMENT);
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Partitions return the rows of the file",
+                 "[partitions]") {
+  std::string path = WriteFile("partitions.csv", SimpleCsvTestRows(200000));
+  std::vector<std::string> partitions =
+      ExecutePartitions(path, {{"partition_size_bytes", "1000000"}});
+  CHECK(partitions.size() > 1);
+  std::vector<std::string> rows;
+  for (const std::string& partition : partitions) {
+    std::vector<std::string> partition_rows = ReadPartition(partition);
+    rows.insert(rows.end(), partition_rows.begin(), partition_rows.end());
+  }
+  CHECK(rows == Read(path));
+
+  // The options that choose the rows and columns go with the partitions
+  SimpleCsvTestOptions options = {{"columns", "name,id"}, {"filter", "id < 10"}};
+  partitions = ExecutePartitions(path, options);
+  REQUIRE(partitions.size() == 1);
+  CHECK(ReadPartition(partitions[0]) == Read(path, options));
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "A partition of a changed file is rejected",
+                 "[partitions]") {
+  std::string contents = SimpleCsvTestRows(1000);
+  std::string path = WriteFile("changed.csv", contents);
+  SetModificationTime(path, 1000000000);
+  std::vector<std::string> partitions = ExecutePartitions(path, {});
+  REQUIRE(partitions.size() == 1);
+  CHECK(ReadPartition(partitions[0]).size() == 1000);
+
+  // Rewrite the file with the same size and header
+  std::replace(contents.begin() + 14, contents.end(), '5', '6');
+  WriteFile("changed.csv", contents);
+  SetModificationTime(path, 1000000001);
+  std::string message = ReadPartitionError(partitions[0]);
+  INFO(message);
+  CHECK(message.find("changed") != std::string::npos);
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Cached schemas are only used for the same file",
+                 "[cache]") {
+  std::string path = WriteFile("schema.csv", "a,b\n1,x\n");
+  SetModificationTime(path, 1000000000);
+  CHECK(ColumnFormats(path) == std::vector<std::string>{"l", "u"});
+  CHECK(ColumnFormats(path, {{"infer_types", "false"}}) ==
+        std::vector<std::string>{"u", "u"});
+  CHECK(ColumnFormats(path) == std::vector<std::string>{"l", "u"});
+
+  // The same size, but a new modification time
+  WriteFile("schema.csv", "a,b\ny,2\n");
+  SetModificationTime(path, 1000000001);
+  CHECK(ColumnFormats(path) == std::vector<std::string>{"u", "l"});
+  CHECK(Read(path) == std::vector<std::string>{"y|2"});
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Cached results are returned for the same read",
+                 "[cache]") {
+  std::string path = WriteFile("results.csv", SimpleCsvTestRows(400000));
+  SimpleCsvTestOptions options = {{"cache_bytes", "100000000"}};
+  std::vector<std::string> expected = Read(path);
+  CHECK(Read(path, options) == expected);
+  CHECK(Read(path, options) == expected);
+
+  // A parallel read ends a batch at the end of each chunk, so it isn't served
+  // the batches of a read on one thread
+  std::vector<int64_t> one_thread = BatchLengths(path, options);
+  std::vector<int64_t> threads = BatchLengths(path, {{"threads", "4"}});
+  CHECK(threads != one_thread);
+  CHECK(BatchLengths(path, {{"cache_bytes", "100000000"}, {"threads", "4"}}) ==
+        threads);
+  CHECK(BatchLengths(path, options) == one_thread);
+
+  // A changed file is read again
+  path = WriteFile("results.csv", SimpleCsvTestRows(10));
+  CHECK(Read(path, options).size() == 10);
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "Sidecars are reused until they are invalid",
+                 "[sidecar]") {
+  std::string dir = "simple_csv_test_sidecars";
+  REQUIRE(mkdir(dir.c_str(), 0755) == 0);
+  RemoveAfterTest(dir);
+
+  std::string contents = "s\n";
+  for (int i = 0; i < 10000; i++) {
+    contents += "value" + std::to_string(i) + "\n";
+  }
+  std::string path = WriteFile("sidecar.csv", contents);
+  std::vector<std::string> expected = Read(path);
+  SimpleCsvTestOptions options = {
+      {"sidecar", "true"}, {"sidecar_dir", dir}, {"batch_size_rows", "1000"}};
+
+  CHECK(Read(path, options) == expected);
+  std::vector<std::string> names = SimpleCsvTestListDirectory(dir);
+  REQUIRE(names.size() == 1);
+  std::string sidecar = dir + "/" + names[0];
+  RemoveAfterTest(sidecar);
+  ino_t inode = SimpleCsvTestInode(sidecar);
+
+  // The second read maps the sidecar rather than writing it again
+  CHECK(Read(path, options) == expected);
+  CHECK(BatchLengths(path, options) == std::vector<int64_t>(10, 1000));
+  CHECK(SimpleCsvTestInode(sidecar) == inode);
+
+  // Offsets that go backwards make the sidecar invalid, so the file is parsed
+  // and the sidecar replaced
+  {
+    std::fstream file(sidecar, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(256);
+    std::string junk(64, '\xff');
+    file.write(junk.data(), junk.size());
+    REQUIRE(file.good());
+  }
+  CHECK(Read(path, options) == expected);
+  CHECK(SimpleCsvTestListDirectory(dir) == names);
+  CHECK(SimpleCsvTestInode(sidecar) != inode);
+  CHECK(Read(path, options) == expected);
+}
+
+TEST_CASE_METHOD(SimpleCsvDriverTest, "An index answers counts, offsets and splits",
+                 "[index]") {
+  std::string path = WriteFile("indexed.csv", SimpleCsvTestRows(200000));
+  RemoveAfterTest(SimpleCsvIndexPath(path, ""));
+  std::vector<std::string> expected = Read(path);
+
+  int64_t rows_affected;
+  CHECK(Read(path, {{"count_only", "true"}}, &rows_affected) ==
+        std::vector<std::string>{"200000"});
+  CHECK(rows_affected == -1);
+  CHECK(Read(path, {{"build_index", "true"}, {"index_interval", "1000"}}) ==
+        std::vector<std::string>{"200000"});
+
+  CHECK(Read(path, {{"index", "true"}, {"count_only", "true"}}, &rows_affected) ==
+        std::vector<std::string>{"200000"});
+  CHECK(rows_affected == 200000);
+
+  std::vector<std::string> rows =
+      Read(path, {{"index", "true"}, {"offset", "150500"}, {"limit", "5"}},
+           &rows_affected);
+  CHECK(rows == std::vector<std::string>(expected.begin() + 150500,
+                                         expected.begin() + 150505));
+  CHECK(rows_affected == 5);
+
+  CHECK(Read(path, {{"index", "true"}, {"threads", "4"}}) == expected);
+  std::vector<std::string> partitions =
+      ExecutePartitions(path, {{"index", "true"}, {"partition_size_bytes", "1000000"}});
+  CHECK(partitions.size() > 1);
+  rows.clear();
+  for (const std::string& partition : partitions) {
+    std::vector<std::string> partition_rows = ReadPartition(partition);
+    rows.insert(rows.end(), partition_rows.begin(), partition_rows.end());
+  }
+  CHECK(rows == expected);
+}
@@ -0,0 +1,145 @@
+
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include "simple_csv_cache.h"
+
+// Adds up the sizes of the buffers of an array and its children
+static int64_t SimpleCsvArrayViewSize(const ArrowArrayView* view) {
+  int64_t size = 0;
+  for (int i = 0; i < 3; i++) {
+    size += view->buffer_views[i].size_bytes;
+  }
+  for (int64_t i = 0; i < view->n_children; i++) {
+    size += SimpleCsvArrayViewSize(view->children[i]);
+  }
+  if (view->dictionary != nullptr) {
+    size += SimpleCsvArrayViewSize(view->dictionary);
+  }
+  return size;
+}
+
+SimpleCsvSharedBatch::SimpleCsvSharedBatch(ArrowArray* array, ArrowSchema* schema)
+    : size_bytes_(0) {
+  ArrowArrayMove(array, array_.get());
+
+  nanoarrow::UniqueArrayView view;
+  ArrowError error;
+  if (ArrowArrayViewInitFromSchema(view.get(), schema, &error) == NANOARROW_OK &&
+      ArrowArrayViewSetArray(view.get(), array_.get(), &error) == NANOARROW_OK) {
+    size_bytes_ = SimpleCsvArrayViewSize(view.get());
+  }
+}
+
+SimpleCsvSharedBatch::SimpleCsvSharedBatch(ArrowArray* array, int64_t size_bytes)
+    : size_bytes_(size_bytes) {
+  ArrowArrayMove(array, array_.get());
+}
+
+// The private data of an array exported by SimpleCsvSharedBatch::Export(),
+// which owns the exported structs of its children and dictionary
+struct SimpleCsvExportedArray {
+  std::shared_ptr<SimpleCsvSharedBatch> batch;
+  std::vector<ArrowArray> children;
+  std::vector<ArrowArray*> child_pointers;
+  ArrowArray dictionary;
+};
+
+static void SimpleCsvExportedArrayRelease(ArrowArray* array) {
+  auto exported = reinterpret_cast<SimpleCsvExportedArray*>(array->private_data);
+
+  // Children that were moved out of the array have already been marked released
+  for (ArrowArray* child : exported->child_pointers) {
+    if (child->release != nullptr) {
+      child->release(child);
+    }
+  }
+  if (exported->dictionary.release != nullptr) {
+    exported->dictionary.release(&exported->dictionary);
+  }
+
+  delete exported;
+  array->release = nullptr;
+}
+
+static void SimpleCsvExportArray(const ArrowArray* array,
+                                 const std::shared_ptr<SimpleCsvSharedBatch>& batch,
+                                 ArrowArray* out) {
+  auto exported = new SimpleCsvExportedArray();
+  exported->batch = batch;
+  exported->children.resize(array->n_children);
+  exported->child_pointers.resize(array->n_children);
+  for (int64_t i = 0; i < array->n_children; i++) {
+    SimpleCsvExportArray(array->children[i], batch, &exported->children[i]);
+    exported->child_pointers[i] = &exported->children[i];
+  }
+
+  memset(&exported->dictionary, 0, sizeof(ArrowArray));
+  if (array->dictionary != nullptr) {
+    SimpleCsvExportArray(array->dictionary, batch, &exported->dictionary);
+  }
+
+  out->length = array->length;
+  out->null_count = array->null_count;
+  out->offset = array->offset;
+  out->n_buffers = array->n_buffers;
+  out->n_children = array->n_children;
+  out->buffers = array->buffers;
+  out->children = array->n_children > 0 ? exported->child_pointers.data() : nullptr;
+  out->dictionary = array->dictionary != nullptr ? &exported->dictionary : nullptr;
+  out->release = &SimpleCsvExportedArrayRelease;
+  out->private_data = exported;
+}
+
+void SimpleCsvSharedBatch::Export(const std::shared_ptr<SimpleCsvSharedBatch>& batch,
+                                  ArrowArray* out) {
+  SimpleCsvExportArray(batch->array_.get(), batch, out);
+}
+
+std::shared_ptr<SimpleCsvCachedResult> SimpleCsvResultCache::Get(
+    const std::string& key, const std::string& identity) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = index_.find(key);
+  if (found == index_.end()) {
+    return nullptr;
+  }
+
+  std::list<Entry>::iterator entry = found->second;
+  if (entry->identity != identity) {
+    // The file has changed since it was read
+    Erase(entry);
+    return nullptr;
+  }
+
+  entries_.splice(entries_.begin(), entries_, entry);
+  return entry->result;
+}
+
+void SimpleCsvResultCache::Put(const std::string& key, const std::string& identity,
+                               std::shared_ptr<SimpleCsvCachedResult> result,
+                               int64_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = index_.find(key);
+  if (found != index_.end()) {
+    Erase(found->second);
+  }
+
+  if (result->size_bytes > budget_bytes) {
+    return;
+  }
+
+  size_bytes_ += result->size_bytes;
+  entries_.push_front(Entry{key, identity, std::move(result)});
+  index_[key] = entries_.begin();
+
+  while (size_bytes_ > budget_bytes) {
+    Erase(std::prev(entries_.end()));
+  }
+}
+
+void SimpleCsvResultCache::Erase(std::list<Entry>::iterator entry) {
+  size_bytes_ -= entry->result->size_bytes;
+  index_.erase(entry->key);
+  entries_.erase(entry);
+}
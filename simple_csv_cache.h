@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "nanoarrow.hpp"
+
+// A finished batch that can be handed out any number of times without copying
+class SimpleCsvSharedBatch {
+ public:
+  // Takes ownership of array, whose buffers are described by schema
+  SimpleCsvSharedBatch(ArrowArray* array, ArrowSchema* schema);
+  // Takes ownership of array, whose buffers are known to hold size_bytes
+  SimpleCsvSharedBatch(ArrowArray* array, int64_t size_bytes);
+
+  // The approximate size of the batch's buffers in bytes
+  int64_t size_bytes() const { return size_bytes_; }
+
+  // Exports the batch as an array that shares its buffers. The batch is kept
+  // alive until out, and each of its children that were moved out of it, are
+  // released.
+  static void Export(const std::shared_ptr<SimpleCsvSharedBatch>& batch,
+                     ArrowArray* out);
+
+ private:
+  nanoarrow::UniqueArray array_;
+  int64_t size_bytes_;
+};
+
+// The result of reading a file: its schema and batches
+struct SimpleCsvCachedResult {
+  nanoarrow::UniqueSchema schema;
+  std::vector<std::shared_ptr<SimpleCsvSharedBatch>> batches;
+  int64_t size_bytes = 0;
+};
+
+// Keeps the results of recent reads in memory up to a budget in bytes, evicting
+// the least recently used. Each result is stored with the identity of the file
+// it was read from (see SimpleCsvFileIdentity()) and only returned for the same
+// version of the file.
+class SimpleCsvResultCache {
+ public:
+  // Returns the result cached for key if it was read from this version of the
+  // file, or nullptr
+  std::shared_ptr<SimpleCsvCachedResult> Get(const std::string& key,
+                                             const std::string& identity);
+
+  // Caches a result, then evicts results until the cache fits in budget_bytes.
+  // A result larger than the budget is not cached.
+  void Put(const std::string& key, const std::string& identity,
+           std::shared_ptr<SimpleCsvCachedResult> result, int64_t budget_bytes);
+
+ private:
+  struct Entry {
+    std::string key;
+    std::string identity;
+    std::shared_ptr<SimpleCsvCachedResult> result;
+  };
+
+  std::mutex mutex_;
+  // Most recently used first
+  std::list<Entry> entries_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  int64_t size_bytes_ = 0;
+
+  void Erase(std::list<Entry>::iterator entry);
+};
@@ -0,0 +1,558 @@
+
+#include <algorithm>
+#include <clocale>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
+
+#include "simple_csv_convert.h"
+#include "simple_csv_pow5.h"
+
+static inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Loads 8 bytes so that the first byte is the least significant
+static inline uint64_t LoadLittleEndian8(const char* data) {
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  value = __builtin_bswap64(value);
+#endif
+  return value;
+}
+
+// True if all 8 bytes are ASCII digits: the high nibble of each byte must be 3
+// and adding 6 must not carry into it
+static inline bool AllDigits8(uint64_t chars) {
+  return ((chars & 0xF0F0F0F0F0F0F0F0) |
+          (((chars + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ==
+         0x3333333333333333;
+}
+
+// Converts 8 ASCII digits to their value with three multiplications, combining
+// pairs of digits, then pairs of pairs, then the two halves
+static inline uint32_t ParseDigits8(uint64_t chars) {
+  uint64_t digits = chars - 0x3030303030303030;
+  digits = (digits * 10) + (digits >> 8);
+  digits = (((digits & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) +
+            (((digits >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >>
+           32;
+  return static_cast<uint32_t>(digits);
+}
+
+bool SimpleCsvParseInt64(ArrowStringView value, int64_t* out) {
+  const char* data = value.data;
+  const char* end = value.data + value.size_bytes;
+  bool negative = false;
+  if (data < end && (*data == '-' || *data == '+')) {
+    negative = *data == '-';
+    data++;
+  }
+
+  if (data == end) {
+    return false;
+  }
+
+  // Leading zeros don't count towards the 19 digits an int64 can hold
+  while (end - data > 1 && *data == '0') {
+    data++;
+  }
+
+  if (end - data > 19) {
+    return false;
+  }
+
+  // Accumulate the magnitude as unsigned so that INT64_MIN can be represented.
+  // 19 digits can't overflow a uint64_t.
+  uint64_t magnitude = 0;
+  while (end - data >= 8) {
+    uint64_t chars = LoadLittleEndian8(data);
+    if (!AllDigits8(chars)) {
+      return false;
+    }
+
+    magnitude = magnitude * 100000000 + ParseDigits8(chars);
+    data += 8;
+  }
+
+  for (; data < end; data++) {
+    if (!IsDigit(*data)) {
+      return false;
+    }
+    magnitude = magnitude * 10 + (*data - '0');
+  }
+
+  uint64_t limit = negative ? uint64_t(std::numeric_limits<int64_t>::max()) + 1
+                            : uint64_t(std::numeric_limits<int64_t>::max());
+  if (magnitude > limit) {
+    return false;
+  }
+
+  *out = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+  return true;
+}
+
+static bool EqualsIgnoreCase(const char* data, int64_t size, const char* word) {
+  int64_t word_size = static_cast<int64_t>(strlen(word));
+  if (size != word_size) {
+    return false;
+  }
+
+  for (int64_t i = 0; i < size; i++) {
+    char c = data[i];
+    if (c >= 'A' && c <= 'Z') {
+      c = c - 'A' + 'a';
+    }
+    if (c != word[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// The product of two 64-bit integers as two 64-bit words
+struct Uint128 {
+  uint64_t low;
+  uint64_t high;
+};
+
+static inline Uint128 MultiplyFull(uint64_t a, uint64_t b) {
+  Uint128 out;
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+  out.low = static_cast<uint64_t>(product);
+  out.high = static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  out.low = _umul128(a, b, &out.high);
+#else
+  uint64_t a_low = a & 0xFFFFFFFF, a_high = a >> 32;
+  uint64_t b_low = b & 0xFFFFFFFF, b_high = b >> 32;
+  uint64_t low_low = a_low * b_low;
+  uint64_t high_low = a_high * b_low;
+  uint64_t low_high = a_low * b_high;
+  uint64_t high_high = a_high * b_high;
+  uint64_t middle = (low_low >> 32) + (high_low & 0xFFFFFFFF) + low_high;
+  out.low = (middle << 32) | (low_low & 0xFFFFFFFF);
+  out.high = high_high + (high_low >> 32) + (middle >> 32);
+#endif
+  return out;
+}
+
+static inline int LeadingZeros(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return 63 - static_cast<int>(index);
+#else
+  return __builtin_clzll(value);
+#endif
+}
+
+// Computes the double nearest to mantissa * 10^exponent (mantissa != 0) with
+// the Eisel-Lemire algorithm (Lemire, "Number Parsing at a Gigabyte per
+// Second", 2021). Returns false in the rare cases where the 128-bit
+// approximation of the power of ten can't decide the rounding.
+static bool EiselLemire(uint64_t mantissa, int64_t exponent, uint64_t* bits) {
+  if (exponent < kSimpleCsvMinPow5) {
+    *bits = 0;
+    return true;
+  } else if (exponent > kSimpleCsvMaxPow5) {
+    *bits = uint64_t(0x7FF) << 52;
+    return true;
+  }
+
+  int leading_zeros = LeadingZeros(mantissa);
+  mantissa <<= leading_zeros;
+
+  // The high 64 bits of mantissa * 5^exponent, with a second multiplication
+  // only if the first one leaves the bits we keep in doubt
+  const uint64_t* pow5 = kSimpleCsvPow5[exponent - kSimpleCsvMinPow5];
+  Uint128 product = MultiplyFull(mantissa, pow5[0]);
+  const uint64_t precision_mask = uint64_t(0xFFFFFFFFFFFFFFFF) >> 55;
+  if ((product.high & precision_mask) == precision_mask) {
+    Uint128 low_product = MultiplyFull(mantissa, pow5[1]);
+    product.low += low_product.high;
+    if (low_product.high > product.low) {
+      product.high++;
+    }
+  }
+
+  if (product.low == 0xFFFFFFFFFFFFFFFF && (exponent < -27 || exponent > 55)) {
+    return false;
+  }
+
+  int upper_bit = static_cast<int>(product.high >> 63);
+  uint64_t significand = product.high >> (upper_bit + 9);
+  // 217706 / 2^16 approximates log2(10)
+  int64_t power2 =
+      (((217706 * exponent) >> 16) + 63) + upper_bit - leading_zeros + 1023;
+
+  if (power2 <= 0) {
+    // Subnormal
+    if (-power2 + 1 >= 64) {
+      *bits = 0;
+      return true;
+    }
+
+    significand >>= -power2 + 1;
+    significand += significand & 1;
+    significand >>= 1;
+    power2 = significand < (uint64_t(1) << 52) ? 0 : 1;
+    *bits = (significand & ~(uint64_t(1) << 52)) | (uint64_t(power2) << 52);
+    return true;
+  }
+
+  // Exactly halfway between two doubles: round to even instead of up
+  if (product.low <= 1 && exponent >= -4 && exponent <= 23 && (significand & 3) == 1 &&
+      (significand << (upper_bit + 9)) == product.high) {
+    significand &= ~uint64_t(1);
+  }
+
+  significand += significand & 1;
+  significand >>= 1;
+  if (significand >= (uint64_t(2) << 52)) {
+    significand = uint64_t(1) << 52;
+    power2++;
+  }
+
+  significand &= ~(uint64_t(1) << 52);
+  if (power2 >= 0x7FF) {
+    power2 = 0x7FF;
+    significand = 0;
+  }
+
+  *bits = significand | (uint64_t(power2) << 52);
+  return true;
+}
+
+// Exact powers of ten for the fast path
+static const double kPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                      1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                      1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Converts a terminated copy of text with strtod() in the C locale
+static double StrtodCLocale(const char* data, int64_t size) {
+  std::string text(data, size);
+#if defined(_WIN32)
+  static _locale_t c_locale = _create_locale(LC_ALL, "C");
+  return _strtod_l(text.c_str(), nullptr, c_locale);
+#elif defined(__GLIBC__) || defined(__APPLE__)
+  static locale_t c_locale = newlocale(LC_ALL_MASK, "C", nullptr);
+  return strtod_l(text.c_str(), nullptr, c_locale);
+#else
+  return strtod(text.c_str(), nullptr);
+#endif
+}
+
+bool SimpleCsvParseDouble(ArrowStringView value, double* out) {
+  const char* start = value.data;
+  const char* data = value.data;
+  const char* end = value.data + value.size_bytes;
+  bool negative = false;
+  if (data < end && (*data == '-' || *data == '+')) {
+    negative = *data == '-';
+    data++;
+  }
+
+  if (EqualsIgnoreCase(data, end - data, "inf") ||
+      EqualsIgnoreCase(data, end - data, "infinity")) {
+    *out = negative ? -std::numeric_limits<double>::infinity()
+                    : std::numeric_limits<double>::infinity();
+    return true;
+  } else if (EqualsIgnoreCase(data, end - data, "nan")) {
+    *out = std::numeric_limits<double>::quiet_NaN();
+    return true;
+  }
+
+  // Collect up to 19 significant digits in mantissa, adjusting exponent so
+  // that the value is mantissa * 10^exponent. Digits past the 19th only make
+  // the value a little bigger, which truncated records.
+  uint64_t mantissa = 0;
+  int64_t exponent = 0;
+  int n_significant = 0;
+  int64_t n_digits = 0;
+  bool truncated = false;
+
+  for (; data < end && IsDigit(*data); data++, n_digits++) {
+    if (n_significant < 19) {
+      mantissa = mantissa * 10 + (*data - '0');
+      n_significant += mantissa != 0;
+    } else {
+      exponent++;
+      truncated |= *data != '0';
+    }
+  }
+
+  if (data < end && *data == '.') {
+    data++;
+    for (; data < end && IsDigit(*data); data++, n_digits++) {
+      if (n_significant < 19) {
+        mantissa = mantissa * 10 + (*data - '0');
+        n_significant += mantissa != 0;
+        exponent--;
+      } else {
+        truncated |= *data != '0';
+      }
+    }
+  }
+
+  if (n_digits == 0) {
+    return false;
+  }
+
+  if (data < end && (*data == 'e' || *data == 'E')) {
+    data++;
+    bool negative_exponent = false;
+    if (data < end && (*data == '-' || *data == '+')) {
+      negative_exponent = *data == '-';
+      data++;
+    }
+
+    if (data == end) {
+      return false;
+    }
+
+    int64_t explicit_exponent = 0;
+    for (; data < end && IsDigit(*data); data++) {
+      // Anything this big is zero or infinity anyway
+      if (explicit_exponent < 100000) {
+        explicit_exponent = explicit_exponent * 10 + (*data - '0');
+      }
+    }
+    exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+  }
+
+  if (data != end) {
+    return false;
+  }
+
+  double result;
+  uint64_t bits;
+  if (mantissa == 0) {
+    result = 0;
+  } else if (!truncated && mantissa <= (uint64_t(1) << 53) && exponent >= -22 &&
+             exponent <= 22) {
+    // Both mantissa and the power of ten are exact doubles, so one correctly
+    // rounded operation gives the correctly rounded result (Clinger, 1990)
+    result = static_cast<double>(mantissa);
+    result = exponent < 0 ? result / kPowersOfTen[-exponent]
+                          : result * kPowersOfTen[exponent];
+  } else {
+    bool exact = EiselLemire(mantissa, exponent, &bits);
+    if (exact && truncated) {
+      // The digits we dropped only matter if they would change the rounding
+      uint64_t bits_up;
+      exact = EiselLemire(mantissa + 1, exponent, &bits_up) && bits_up == bits;
+    }
+
+    if (!exact) {
+      // Hard cases need arbitrary precision
+      *out = StrtodCLocale(start, value.size_bytes);
+      return true;
+    }
+
+    memcpy(&result, &bits, sizeof(result));
+  }
+
+  *out = negative ? -result : result;
+  return true;
+}
+
+bool SimpleCsvParseBool(ArrowStringView value, bool* out) {
+  if (EqualsIgnoreCase(value.data, value.size_bytes, "true")) {
+    *out = true;
+    return true;
+  } else if (EqualsIgnoreCase(value.data, value.size_bytes, "false")) {
+    *out = false;
+    return true;
+  } else {
+    return false;
+  }
+}
+
+// Days since 1970-01-01 of a date in the proleptic Gregorian calendar
+// (http://howardhinnant.github.io/date_algorithms.html#days_from_civil)
+static int64_t DaysFromCivil(int64_t year, int64_t month, int64_t day) {
+  year -= month <= 2;
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  int64_t year_of_era = year - era * 400;
+  int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int64_t day_of_era =
+      year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+static bool IsLeapYear(int64_t year) {
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+// Per-byte masks selecting the bytes of a word that must be digits
+static constexpr uint64_t DigitMask(uint64_t bytes) { return bytes * 0xFF; }
+
+// Checks that the bytes of chars selected by mask are ASCII digits and
+// returns them as numbers (other bytes are zero) in *digits
+static inline bool ExtractDigits(uint64_t chars, uint64_t mask, uint64_t* digits) {
+  uint64_t high = 0xF0F0F0F0F0F0F0F0 & mask;
+  uint64_t zero = 0x3030303030303030 & mask;
+  if ((chars & high) != zero || ((chars + (0x0606060606060606 & mask)) & high) != zero) {
+    return false;
+  }
+
+  *digits = (chars & mask) - zero;
+  return true;
+}
+
+// Combines each byte of digits with the next one, so that byte i of the
+// result is the two-digit number starting at byte i
+static inline uint64_t DigitPairs(uint64_t digits) { return digits * 10 + (digits >> 8); }
+
+static inline int PairAt(uint64_t pairs, int byte) {
+  return static_cast<int>((pairs >> (8 * byte)) & 0xFF);
+}
+
+// The layout of YYYY-MM-DDTHH:MM:SS, looked at one 8-byte word at a time.
+// Byte i of a mask is 0x01 where the layout has a digit and each separator
+// word has the separators that must be present.
+static constexpr uint64_t kDateDigits0 = DigitMask(0x0001010001010101);  // YYYY-MM-
+static constexpr uint64_t kDateSeparators0 = 0x2D00002D00000000;
+static constexpr uint64_t kTimeDigits1 = DigitMask(0x0101000101000101);  // DDTHH:MM
+static constexpr uint64_t kTimeSeparators1 = 0x00003A0000000000;
+static constexpr uint64_t kTimeDigits2 = DigitMask(0x0000000000010100);  // :SS
+static constexpr uint64_t kTimeSeparators2 = 0x000000000000003A;
+
+// Parses the YYYY-MM-DD at the start of a 16-byte buffer
+static inline bool ParseDateWords(const char* buffer, int64_t* days) {
+  uint64_t word0 = LoadLittleEndian8(buffer);
+  uint64_t word1 = LoadLittleEndian8(buffer + 8);
+  uint64_t digits0, digits1;
+  if ((word0 & ~kDateDigits0) != kDateSeparators0 ||
+      !ExtractDigits(word0, kDateDigits0, &digits0) ||
+      !ExtractDigits(word1, DigitMask(0x0101), &digits1)) {
+    return false;
+  }
+
+  uint64_t pairs0 = DigitPairs(digits0);
+  int64_t year = PairAt(pairs0, 0) * 100 + PairAt(pairs0, 2);
+  int month = PairAt(pairs0, 5);
+  int day = PairAt(DigitPairs(digits1), 0);
+
+  static const int kDaysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if (month < 1 || month > 12 || day < 1 ||
+      day > kDaysInMonth[month - 1] + (month == 2 && IsLeapYear(year))) {
+    return false;
+  }
+
+  *days = DaysFromCivil(year, month, day);
+  return true;
+}
+
+// Copies a field into a zero-padded buffer so that the layout can be checked
+// with whole-word loads without reading past the end of the field
+static inline void CopyPadded(ArrowStringView value, char* buffer, int64_t size) {
+  memset(buffer, 0, size);
+  memcpy(buffer, value.data, std::min<int64_t>(value.size_bytes, size));
+}
+
+bool SimpleCsvParseDate32(ArrowStringView value, int32_t* out) {
+  if (value.size_bytes != 10) {
+    return false;
+  }
+
+  char buffer[16];
+  CopyPadded(value, buffer, sizeof(buffer));
+  int64_t days;
+  if (!ParseDateWords(buffer, &days)) {
+    return false;
+  }
+
+  *out = static_cast<int32_t>(days);
+  return true;
+}
+
+bool SimpleCsvParseTimestamp(ArrowStringView value, int64_t* out) {
+  int64_t size = value.size_bytes;
+  if (size < 10) {
+    return false;
+  }
+
+  char buffer[24];
+  CopyPadded(value, buffer, sizeof(buffer));
+  int64_t days;
+  if (!ParseDateWords(buffer, &days)) {
+    return false;
+  }
+
+  int64_t micros = days * 86400 * 1000000;
+  if (size == 10) {
+    *out = micros;
+    return true;
+  }
+
+  const char* data = value.data;
+  if (data[size - 1] == 'Z') {
+    size--;
+  }
+
+  // DDTHH:MM, where T may also be a space
+  uint64_t word1 = LoadLittleEndian8(buffer + 8);
+  uint64_t digits1;
+  if (size < 16 || (buffer[10] != 'T' && buffer[10] != ' ') ||
+      (word1 & 0x0000FF0000000000) != kTimeSeparators1 ||
+      !ExtractDigits(word1, kTimeDigits1, &digits1)) {
+    return false;
+  }
+
+  uint64_t pairs1 = DigitPairs(digits1);
+  int hour = PairAt(pairs1, 3);
+  int minute = PairAt(pairs1, 6);
+  int second = 0;
+  if (hour > 23 || minute > 59) {
+    return false;
+  }
+
+  // :SS
+  int64_t pos = 16;
+  if (pos < size) {
+    uint64_t word2 = LoadLittleEndian8(buffer + 16);
+    uint64_t digits2;
+    if (size < 19 || (word2 & 0xFF) != kTimeSeparators2 ||
+        !ExtractDigits(word2, kTimeDigits2, &digits2)) {
+      return false;
+    }
+
+    second = PairAt(DigitPairs(digits2), 1);
+    if (second > 60) {
+      return false;
+    }
+    pos = 19;
+  }
+
+  // .fraction, of which digits beyond microseconds are truncated
+  int64_t fraction = 0;
+  if (pos < size) {
+    if (data[pos] != '.' || pos + 1 == size) {
+      return false;
+    }
+
+    int64_t scale = 100000;
+    for (pos++; pos < size; pos++) {
+      if (!IsDigit(data[pos])) {
+        return false;
+      }
+      fraction += (data[pos] - '0') * scale;
+      scale /= 10;
+    }
+  }
+
+  *out = micros + ((hour * 60 + minute) * 60 + second) * int64_t(1000000) + fraction;
+  return true;
+}
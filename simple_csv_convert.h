@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+#include "nanoarrow.h"
+
+// Conversions from the text of a field to the value of a typed column. Each
+// returns false unless all of value is valid text for the type.
+
+// An optional sign followed by decimal digits that fit in an int64
+bool SimpleCsvParseInt64(ArrowStringView value, int64_t* out);
+
+// A decimal number with an optional fraction and exponent, or inf/nan
+bool SimpleCsvParseDouble(ArrowStringView value, double* out);
+
+// true or false in any case
+bool SimpleCsvParseBool(ArrowStringView value, bool* out);
+
+// YYYY-MM-DD as days since the epoch
+bool SimpleCsvParseDate32(ArrowStringView value, int32_t* out);
+
+// YYYY-MM-DD, optionally followed by T or a space, HH:MM[:SS[.fraction]] and Z,
+// as microseconds since the epoch. The time zone is not recorded.
+bool SimpleCsvParseTimestamp(ArrowStringView value, int64_t* out);
@@ -0,0 +1,177 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+#include <catch2/catch.hpp>
+
+#include "simple_csv_convert.h"
+
+static ArrowStringView View(const std::string& value) {
+  return ArrowStringView{value.data(), static_cast<int64_t>(value.size())};
+}
+
+static uint64_t Bits(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// glibc's strtod() is correctly rounded, so it is the reference for the
+// results of SimpleCsvParseDouble()
+static void CheckSameAsStrtod(const std::string& text) {
+  INFO(text);
+  double value;
+  REQUIRE(SimpleCsvParseDouble(View(text), &value));
+  CHECK(Bits(value) == Bits(strtod(text.c_str(), nullptr)));
+}
+
+TEST_CASE("SimpleCsvParseDouble rounds hard cases correctly", "[convert]") {
+  const char* cases[] = {
+      // The Clinger fast path: mantissa <= 2^53 and |exponent| <= 22
+      "1e22", "1e-22", "9007199254740992", "9007199254740992e22", "9007199254740992e-22",
+      "1e23", "9007199254740993e22", "9007199254740992e23", "0.1", "0.3", "123.456",
+      // Halfway between two doubles, which rounds to even
+      "9007199254740993", "9007199254740995", "72057594037927933",
+      "1.00000000000000011102230246251565404236316680908203125",
+      "1.00000000000000011102230246251565404236316680908203124",
+      "1.00000000000000011102230246251565404236316680908203126",
+      "7.2057594037927933e16", "4.5035996273704963e15",
+      // Mantissas with 19 or more digits, some of which fall back to strtod()
+      "1234567890123456789", "12345678901234567890", "123456789012345678901234567890",
+      "0.1000000000000000055511151231257827021181583404541015625",
+      "3.14159265358979323846264338327950288419716939937510582097494459",
+      "18446744073709551615", "18446744073709551616", "9999999999999999999",
+      "99999999999999999999999999999999999999999999999999e-50",
+      // Subnormals and the edges of the range
+      "4.9406564584124654e-324", "2.4703282292062327e-324", "2.4703282292062328e-324",
+      "2.2250738585072011e-308", "2.2250738585072012e-308", "2.2250738585072014e-308",
+      "2.225073858507201136057409796709131975934819546351645648e-308", "1e-320",
+      "1.5e-323", "1e-400", "1.7976931348623157e308", "1.7976931348623158e308",
+      "1.7976931348623159e308", "1e309", "8.98846567431158e307",
+      // Signs, zeros and forms without digits on one side of the point
+      "-0", "0e999", "-1.5", "+2.5", ".5", "5.", "1E5", "1e+5", "1e-5", "000001.0000"};
+  for (const char* text : cases) {
+    CheckSameAsStrtod(text);
+  }
+
+  double value;
+  REQUIRE(SimpleCsvParseDouble(View("9007199254740993"), &value));
+  CHECK(value == 9007199254740992.0);
+  REQUIRE(SimpleCsvParseDouble(
+      View("1.00000000000000011102230246251565404236316680908203125"), &value));
+  CHECK(value == 1.0);
+  REQUIRE(SimpleCsvParseDouble(View("4.9406564584124654e-324"), &value));
+  CHECK(value == std::numeric_limits<double>::denorm_min());
+  REQUIRE(SimpleCsvParseDouble(View("-0"), &value));
+  CHECK(std::signbit(value));
+}
+
+TEST_CASE("SimpleCsvParseDouble matches strtod() on random numbers", "[convert]") {
+  std::mt19937_64 random(42);
+  for (int i = 0; i < 100000; i++) {
+    std::string text = std::to_string(random() >> (random() % 64));
+    int n_digits = static_cast<int>(random() % 25);
+    if (n_digits > 0) {
+      text += ".";
+      for (int j = 0; j < n_digits; j++) {
+        text += static_cast<char>('0' + random() % 10);
+      }
+    }
+    text += "e" + std::to_string(static_cast<int>(random() % 700) - 350);
+    CheckSameAsStrtod(text);
+  }
+}
+
+TEST_CASE("SimpleCsvParseDouble reads special values", "[convert]") {
+  double value;
+  REQUIRE(SimpleCsvParseDouble(View("inf"), &value));
+  CHECK(value == std::numeric_limits<double>::infinity());
+  REQUIRE(SimpleCsvParseDouble(View("-Infinity"), &value));
+  CHECK(value == -std::numeric_limits<double>::infinity());
+  REQUIRE(SimpleCsvParseDouble(View("NaN"), &value));
+  CHECK(std::isnan(value));
+}
+
+TEST_CASE("SimpleCsvParseDouble rejects invalid text", "[convert]") {
+  const char* cases[] = {"",   ".",   "e5",  "1e",      "1e+", "--1", "1.2.3",
+                         "0x10", " 1", "1 ", "1,5", "infinit", "+"};
+  for (const char* text : cases) {
+    INFO(text);
+    double value;
+    CHECK_FALSE(SimpleCsvParseDouble(View(text), &value));
+  }
+}
+
+TEST_CASE("SimpleCsvParseDate32 reads ISO 8601 dates", "[convert]") {
+  int32_t value;
+  REQUIRE(SimpleCsvParseDate32(View("1970-01-01"), &value));
+  CHECK(value == 0);
+  REQUIRE(SimpleCsvParseDate32(View("2020-02-29"), &value));
+  CHECK(value == 18321);
+  REQUIRE(SimpleCsvParseDate32(View("1969-12-31"), &value));
+  CHECK(value == -1);
+
+  const char* cases[] = {"2019-02-29", "2020-13-01", "2020-00-10", "2020-01-32",
+                         "2020/01/01", "2020-1-01",  "20200101",   "2020-01-01 "};
+  for (const char* text : cases) {
+    INFO(text);
+    CHECK_FALSE(SimpleCsvParseDate32(View(text), &value));
+  }
+}
+
+TEST_CASE("SimpleCsvParseTimestamp reads ISO 8601 timestamps", "[convert]") {
+  const int64_t day = 18262 * int64_t(86400000000);  // 2020-01-01
+  int64_t value;
+  REQUIRE(SimpleCsvParseTimestamp(View("2020-01-01"), &value));
+  CHECK(value == day);
+  REQUIRE(SimpleCsvParseTimestamp(View("2020-01-01T12:30"), &value));
+  CHECK(value == day + int64_t(45000000000));
+  REQUIRE(SimpleCsvParseTimestamp(View("2020-01-01 12:30:15Z"), &value));
+  CHECK(value == day + int64_t(45015000000));
+  REQUIRE(SimpleCsvParseTimestamp(View("2020-01-01T12:30:15.1234567"), &value));
+  CHECK(value == day + int64_t(45015123456));
+
+  // Every separator is compared exactly, not just the bits it has set
+  const char* cases[] = {"2020-01-01T12;30",      "2020-01-01T12?30",
+                         "2020-01-01T12~30:00",   "2020-01-01 12z30",
+                         "2020-01-01T12:30;00",   "2020-01-01T12:30:00,5",
+                         "2020-01-01X12:30",      "2020-01-01T24:00",
+                         "2020-01-01T12:60",      "2020-01-01T12:30:00.",
+                         "2020-01-01T1:30",       "2020-01-01T12:30:5"};
+  for (const char* text : cases) {
+    INFO(text);
+    CHECK_FALSE(SimpleCsvParseTimestamp(View(text), &value));
+  }
+}
+
+TEST_CASE("SimpleCsvParseInt64 reads the whole int64 range", "[convert]") {
+  int64_t value;
+  REQUIRE(SimpleCsvParseInt64(View("9223372036854775807"), &value));
+  CHECK(value == std::numeric_limits<int64_t>::max());
+  REQUIRE(SimpleCsvParseInt64(View("-9223372036854775808"), &value));
+  CHECK(value == std::numeric_limits<int64_t>::min());
+  REQUIRE(SimpleCsvParseInt64(View("+0012345678901"), &value));
+  CHECK(value == 12345678901);
+
+  // Every number of digits, which are parsed eight at a time
+  int64_t expected = 0;
+  for (int n_digits = 1; n_digits <= 18; n_digits++) {
+    expected = expected * 10 + n_digits % 10;
+    std::string text = std::to_string(expected);
+    INFO(text);
+    REQUIRE(SimpleCsvParseInt64(View(text), &value));
+    CHECK(value == expected);
+    REQUIRE(SimpleCsvParseInt64(View("-" + text), &value));
+    CHECK(value == -expected);
+  }
+
+  CHECK_FALSE(SimpleCsvParseInt64(View("9223372036854775808"), &value));
+  CHECK_FALSE(SimpleCsvParseInt64(View("-9223372036854775809"), &value));
+  CHECK_FALSE(SimpleCsvParseInt64(View(""), &value));
+  CHECK_FALSE(SimpleCsvParseInt64(View("-"), &value));
+  CHECK_FALSE(SimpleCsvParseInt64(View("12345678a"), &value));
+}
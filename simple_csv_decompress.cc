@@ -0,0 +1,257 @@
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#if defined(SIMPLE_CSV_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined(SIMPLE_CSV_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+#include "simple_csv_decompress.h"
+
+SimpleCsvCompression SimpleCsvDetectCompression(const std::string& filename) {
+  std::ifstream input(filename, std::ios::binary);
+  unsigned char magic[4] = {0, 0, 0, 0};
+  input.read(reinterpret_cast<char*>(magic), sizeof(magic));
+  int64_t size = input.gcount();
+
+  if (size >= 2 && magic[0] == 0x1F && magic[1] == 0x8B) {
+    return SimpleCsvCompression::GZIP;
+  } else if (size == 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F &&
+             magic[3] == 0xFD) {
+    return SimpleCsvCompression::ZSTD;
+  } else {
+    return SimpleCsvCompression::NONE;
+  }
+}
+
+class SimpleCsvDecompressSource::Decoder {
+ public:
+  explicit Decoder(const std::string& filename) : filename_(filename) {}
+  virtual ~Decoder() {}
+
+  virtual int Init(ArrowError* error) = 0;
+
+  // Decompresses from [*in, in_end) into [*out, out_end), advancing *in and
+  // *out past what was used. Sets *at_end if the input used so far ends with
+  // a complete member or frame.
+  virtual int Decompress(const char** in, const char* in_end, char** out,
+                         char* out_end, bool* at_end, ArrowError* error) = 0;
+
+ protected:
+  const std::string& filename_;
+};
+
+#if defined(SIMPLE_CSV_HAVE_ZLIB)
+
+class SimpleCsvGzipDecoder : public SimpleCsvDecompressSource::Decoder {
+ public:
+  explicit SimpleCsvGzipDecoder(const std::string& filename)
+      : Decoder(filename), initialized_(false) {
+    memset(&stream_, 0, sizeof(stream_));
+  }
+
+  ~SimpleCsvGzipDecoder() override {
+    if (initialized_) {
+      inflateEnd(&stream_);
+    }
+  }
+
+  int Init(ArrowError* error) override {
+    // 32 lets zlib detect the gzip header
+    if (inflateInit2(&stream_, 15 + 32) != Z_OK) {
+      ArrowErrorSet(error, "Failed to start decompressing '%s'", filename_.c_str());
+      return ENOMEM;
+    }
+
+    initialized_ = true;
+    return NANOARROW_OK;
+  }
+
+  int Decompress(const char** in, const char* in_end, char** out, char* out_end,
+                 bool* at_end, ArrowError* error) override {
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(*in));
+    stream_.avail_in = static_cast<uInt>(std::min<int64_t>(in_end - *in, UINT_MAX));
+    stream_.next_out = reinterpret_cast<Bytef*>(*out);
+    stream_.avail_out = static_cast<uInt>(std::min<int64_t>(out_end - *out, UINT_MAX));
+
+    int result = inflate(&stream_, Z_NO_FLUSH);
+    const char* next_in = reinterpret_cast<const char*>(stream_.next_in);
+    if (next_in != *in) {
+      *at_end = false;
+    }
+    *in = next_in;
+    *out = reinterpret_cast<char*>(stream_.next_out);
+
+    switch (result) {
+      case Z_STREAM_END:
+        // Another member may follow
+        *at_end = true;
+        inflateReset(&stream_);
+        return NANOARROW_OK;
+      case Z_OK:
+      case Z_BUF_ERROR:
+        return NANOARROW_OK;
+      default:
+        ArrowErrorSet(error, "Failed to decompress '%s': %s", filename_.c_str(),
+                      stream_.msg != nullptr ? stream_.msg : "invalid gzip data");
+        return EIO;
+    }
+  }
+
+ private:
+  z_stream stream_;
+  bool initialized_;
+};
+
+#endif
+
+#if defined(SIMPLE_CSV_HAVE_ZSTD)
+
+class SimpleCsvZstdDecoder : public SimpleCsvDecompressSource::Decoder {
+ public:
+  explicit SimpleCsvZstdDecoder(const std::string& filename)
+      : Decoder(filename), stream_(nullptr) {}
+
+  ~SimpleCsvZstdDecoder() override {
+    if (stream_ != nullptr) {
+      ZSTD_freeDStream(stream_);
+    }
+  }
+
+  int Init(ArrowError* error) override {
+    stream_ = ZSTD_createDStream();
+    if (stream_ == nullptr || ZSTD_isError(ZSTD_initDStream(stream_))) {
+      ArrowErrorSet(error, "Failed to start decompressing '%s'", filename_.c_str());
+      return ENOMEM;
+    }
+
+    return NANOARROW_OK;
+  }
+
+  int Decompress(const char** in, const char* in_end, char** out, char* out_end,
+                 bool* at_end, ArrowError* error) override {
+    ZSTD_inBuffer input = {*in, static_cast<size_t>(in_end - *in), 0};
+    ZSTD_outBuffer output = {*out, static_cast<size_t>(out_end - *out), 0};
+    size_t result = ZSTD_decompressStream(stream_, &output, &input);
+    if (ZSTD_isError(result)) {
+      ArrowErrorSet(error, "Failed to decompress '%s': %s", filename_.c_str(),
+                    ZSTD_getErrorName(result));
+      return EIO;
+    }
+
+    *in += input.pos;
+    *out += output.pos;
+    // Zero means that a frame was completely decoded and flushed
+    *at_end = result == 0;
+    return NANOARROW_OK;
+  }
+
+ private:
+  ZSTD_DStream* stream_;
+};
+
+#endif
+
+SimpleCsvDecompressSource::SimpleCsvDecompressSource(const std::string& filename,
+                                                     SimpleCsvCompression compression,
+                                                     int64_t offset)
+    : filename_(filename),
+      compression_(compression),
+      skip_(offset),
+      in_pos_(0),
+      in_size_(0),
+      in_eof_(false),
+      at_end_(false) {}
+
+SimpleCsvDecompressSource::~SimpleCsvDecompressSource() {}
+
+int SimpleCsvDecompressSource::Open(ArrowError* error) {
+  switch (compression_) {
+#if defined(SIMPLE_CSV_HAVE_ZLIB)
+    case SimpleCsvCompression::GZIP:
+      decoder_.reset(new SimpleCsvGzipDecoder(filename_));
+      break;
+#endif
+#if defined(SIMPLE_CSV_HAVE_ZSTD)
+    case SimpleCsvCompression::ZSTD:
+      decoder_.reset(new SimpleCsvZstdDecoder(filename_));
+      break;
+#endif
+    default:
+      ArrowErrorSet(error, "'%s' is %s-compressed, which this driver was built without",
+                    filename_.c_str(),
+                    compression_ == SimpleCsvCompression::GZIP ? "gzip" : "zstd");
+      return ENOTSUP;
+  }
+
+  NANOARROW_RETURN_NOT_OK(decoder_->Init(error));
+
+  input_.open(filename_, std::ios::binary);
+  if (!input_.is_open()) {
+    ArrowErrorSet(error, "Failed to open '%s'", filename_.c_str());
+    return ENOENT;
+  }
+
+  in_.resize(kInputSize);
+  return NANOARROW_OK;
+}
+
+int SimpleCsvDecompressSource::FillInput(ArrowError* error) {
+  input_.read(in_.data(), in_.size());
+  if (input_.bad()) {
+    ArrowErrorSet(error, "Failed to read from '%s'", filename_.c_str());
+    return EIO;
+  }
+
+  in_pos_ = 0;
+  in_size_ = input_.gcount();
+  in_eof_ = in_size_ == 0;
+  return NANOARROW_OK;
+}
+
+int SimpleCsvDecompressSource::Read(char* out, int64_t capacity, int64_t* bytes_read,
+                                    ArrowError* error) {
+  char* pos = out;
+  char* end = out + capacity;
+  while (pos < end) {
+    if (in_pos_ == in_size_) {
+      if (!in_eof_) {
+        NANOARROW_RETURN_NOT_OK(FillInput(error));
+        continue;
+      }
+
+      if (!at_end_) {
+        ArrowErrorSet(error, "Unexpected end of compressed data in '%s'",
+                      filename_.c_str());
+        return EIO;
+      }
+
+      break;
+    }
+
+    char* start = pos;
+    const char* in = in_.data() + in_pos_;
+    NANOARROW_RETURN_NOT_OK(
+        decoder_->Decompress(&in, in_.data() + in_size_, &pos, end, &at_end_, error));
+    in_pos_ = in - in_.data();
+
+    // Drop what comes before the offset
+    if (skip_ > 0) {
+      int64_t n = std::min<int64_t>(skip_, pos - start);
+      memmove(start, start + n, pos - start - n);
+      pos -= n;
+      skip_ -= n;
+    }
+  }
+
+  *bytes_read = pos - out;
+  return NANOARROW_OK;
+}
+
+constexpr int64_t SimpleCsvDecompressSource::kInputSize;
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "nanoarrow.h"
+#include "simple_csv_input.h"
+
+enum class SimpleCsvCompression { NONE, GZIP, ZSTD };
+
+// Identifies the compression of a file from the magic number at its start.
+// Files that can't be read are NONE, so that opening them reports the error.
+SimpleCsvCompression SimpleCsvDetectCompression(const std::string& filename);
+
+// Produces the decompressed bytes of a gzip or zstd file, starting offset bytes
+// into the decompressed data. Used as the source of a SimpleCsvReadaheadInput,
+// decompression runs on the input's background thread and overlaps with parsing.
+// Concatenated gzip members and zstd frames are read as one stream.
+class SimpleCsvDecompressSource : public SimpleCsvBlockSource {
+ public:
+  SimpleCsvDecompressSource(const std::string& filename, SimpleCsvCompression compression,
+                            int64_t offset);
+  ~SimpleCsvDecompressSource() override;
+
+  int Open(ArrowError* error) override;
+  int Read(char* out, int64_t capacity, int64_t* bytes_read, ArrowError* error) override;
+
+  // The state of a decompressor for one format
+  class Decoder;
+
+ private:
+  static constexpr int64_t kInputSize = 256 * 1024;
+
+  std::string filename_;
+  SimpleCsvCompression compression_;
+  // Decompressed bytes still to be dropped before the offset
+  int64_t skip_;
+  std::ifstream input_;
+  std::vector<char> in_;
+  int64_t in_pos_;
+  int64_t in_size_;
+  bool in_eof_;
+  // True if the input so far ends with a complete gzip member or zstd frame
+  bool at_end_;
+  std::unique_ptr<Decoder> decoder_;
+
+  int FillInput(ArrowError* error);
+};
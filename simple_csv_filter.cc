@@ -0,0 +1,433 @@
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "simple_csv_convert.h"
+#include "simple_csv_filter.h"
+
+void SimpleCsvFilterColumn::Clear() {
+  ints.clear();
+  doubles.clear();
+  strings.clear();
+  valid.clear();
+}
+
+bool SimpleCsvFilterColumn::Append(ArrowStringView value) {
+  bool is_valid = value.data != nullptr;
+  valid.push_back(is_valid);
+
+  bool ok = true;
+  switch (type) {
+    case SimpleCsvColumnType::STRING:
+    case SimpleCsvColumnType::DICTIONARY:
+      strings.push_back(value);
+      return true;
+    case SimpleCsvColumnType::DOUBLE: {
+      double parsed = 0;
+      ok = !is_valid || SimpleCsvParseDouble(value, &parsed);
+      doubles.push_back(parsed);
+      return ok;
+    }
+    case SimpleCsvColumnType::BOOL: {
+      bool parsed = false;
+      ok = !is_valid || SimpleCsvParseBool(value, &parsed);
+      ints.push_back(parsed);
+      return ok;
+    }
+    case SimpleCsvColumnType::DATE32: {
+      int32_t parsed = 0;
+      ok = !is_valid || SimpleCsvParseDate32(value, &parsed);
+      ints.push_back(parsed);
+      return ok;
+    }
+    case SimpleCsvColumnType::TIMESTAMP: {
+      int64_t parsed = 0;
+      ok = !is_valid || SimpleCsvParseTimestamp(value, &parsed);
+      ints.push_back(parsed);
+      return ok;
+    }
+    default: {
+      int64_t parsed = 0;
+      ok = !is_valid || SimpleCsvParseInt64(value, &parsed);
+      ints.push_back(parsed);
+      return ok;
+    }
+  }
+}
+
+// A recursive descent parser for the expressions accepted by SimpleCsvFilter,
+// where AND binds more tightly than OR
+class SimpleCsvFilterParser {
+ public:
+  SimpleCsvFilterParser(const std::string& text, const std::vector<std::string>& names,
+                        SimpleCsvFilter* filter, ArrowError* error)
+      : text_(text), names_(names), filter_(filter), error_(error), pos_(0) {}
+
+  int Parse() {
+    int64_t root;
+    NANOARROW_RETURN_NOT_OK(ParseOr(&root));
+    SkipSpace();
+    if (pos_ < text_.size()) {
+      return Expected("AND, OR or the end of the expression");
+    }
+
+    filter_->root_ = root;
+    return NANOARROW_OK;
+  }
+
+ private:
+  const std::string& text_;
+  const std::vector<std::string>& names_;
+  SimpleCsvFilter* filter_;
+  ArrowError* error_;
+  size_t pos_;
+
+  int ParseOr(int64_t* out) {
+    NANOARROW_RETURN_NOT_OK(ParseAnd(out));
+    while (Keyword("OR")) {
+      int64_t right;
+      NANOARROW_RETURN_NOT_OK(ParseAnd(&right));
+      *out = AddNode(SimpleCsvFilter::NodeKind::OR, *out, right);
+    }
+
+    return NANOARROW_OK;
+  }
+
+  int ParseAnd(int64_t* out) {
+    NANOARROW_RETURN_NOT_OK(ParsePrimary(out));
+    while (Keyword("AND")) {
+      int64_t right;
+      NANOARROW_RETURN_NOT_OK(ParsePrimary(&right));
+      *out = AddNode(SimpleCsvFilter::NodeKind::AND, *out, right);
+    }
+
+    return NANOARROW_OK;
+  }
+
+  int ParsePrimary(int64_t* out) {
+    SkipSpace();
+    if (pos_ < text_.size() && text_[pos_] == '(') {
+      pos_++;
+      NANOARROW_RETURN_NOT_OK(ParseOr(out));
+      SkipSpace();
+      if (pos_ == text_.size() || text_[pos_] != ')') {
+        return Expected("')'");
+      }
+      pos_++;
+      return NANOARROW_OK;
+    }
+
+    return ParseComparison(out);
+  }
+
+  int ParseComparison(int64_t* out) {
+    SimpleCsvFilter::Node node;
+    node.kind = SimpleCsvFilter::NodeKind::COMPARE;
+    node.left = node.right = -1;
+    node.int_literal = 0;
+    node.double_literal = 0;
+
+    std::string name;
+    NANOARROW_RETURN_NOT_OK(ParseWord('"', "a column name", &name));
+    auto found = std::find(names_.begin(), names_.end(), name);
+    if (found == names_.end()) {
+      ArrowErrorSet(error_, "Column '%s' in filter not found", name.c_str());
+      return EINVAL;
+    }
+
+    int64_t index = found - names_.begin();
+    std::vector<int64_t>& columns = filter_->columns_;
+    auto column = std::find(columns.begin(), columns.end(), index);
+    node.column = column - columns.begin();
+    if (column == columns.end()) {
+      columns.push_back(index);
+      filter_->column_names_.push_back(name);
+    }
+
+    NANOARROW_RETURN_NOT_OK(ParseOp(&node.op));
+    NANOARROW_RETURN_NOT_OK(ParseWord('\'', "a value", &node.literal));
+
+    filter_->nodes_.push_back(node);
+    *out = filter_->nodes_.size() - 1;
+    return NANOARROW_OK;
+  }
+
+  int ParseOp(SimpleCsvFilter::Op* out) {
+    static const struct {
+      const char* text;
+      SimpleCsvFilter::Op op;
+    } kOps[] = {{"==", SimpleCsvFilter::Op::EQ}, {"!=", SimpleCsvFilter::Op::NE},
+                {"<>", SimpleCsvFilter::Op::NE}, {"<=", SimpleCsvFilter::Op::LE},
+                {">=", SimpleCsvFilter::Op::GE}, {"=", SimpleCsvFilter::Op::EQ},
+                {"<", SimpleCsvFilter::Op::LT},  {">", SimpleCsvFilter::Op::GT}};
+
+    SkipSpace();
+    for (const auto& op : kOps) {
+      size_t size = strlen(op.text);
+      if (text_.compare(pos_, size, op.text) == 0) {
+        pos_ += size;
+        *out = op.op;
+        return NANOARROW_OK;
+      }
+    }
+
+    return Expected("a comparison operator");
+  }
+
+  // Parses a word that is either enclosed in quote characters (doubled to
+  // escape them) or ends before whitespace, a parenthesis or an operator
+  int ParseWord(char quote, const char* what, std::string* out) {
+    SkipSpace();
+    out->clear();
+    if (pos_ < text_.size() && text_[pos_] == quote) {
+      for (pos_++; pos_ < text_.size(); pos_++) {
+        if (text_[pos_] == quote) {
+          if (pos_ + 1 < text_.size() && text_[pos_ + 1] == quote) {
+            pos_++;
+          } else {
+            pos_++;
+            return NANOARROW_OK;
+          }
+        }
+        out->push_back(text_[pos_]);
+      }
+
+      return Expected("a closing quote");
+    }
+
+    while (pos_ < text_.size() && !IsSpace(text_[pos_]) &&
+           strchr("()=!<>'\"", text_[pos_]) == nullptr) {
+      out->push_back(text_[pos_++]);
+    }
+
+    if (out->empty()) {
+      return Expected(what);
+    }
+
+    return NANOARROW_OK;
+  }
+
+  // Consumes a keyword (in any case) if it is next
+  bool Keyword(const char* keyword) {
+    SkipSpace();
+    size_t size = strlen(keyword);
+    if (text_.size() - pos_ < size) {
+      return false;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+      if (toupper(static_cast<unsigned char>(text_[pos_ + i])) != keyword[i]) {
+        return false;
+      }
+    }
+
+    size_t end = pos_ + size;
+    if (end < text_.size() && !IsSpace(text_[end]) && text_[end] != '(') {
+      return false;
+    }
+
+    pos_ = end;
+    return true;
+  }
+
+  int64_t AddNode(SimpleCsvFilter::NodeKind kind, int64_t left, int64_t right) {
+    SimpleCsvFilter::Node node;
+    node.kind = kind;
+    node.left = left;
+    node.right = right;
+    node.column = -1;
+    node.op = SimpleCsvFilter::Op::EQ;
+    node.int_literal = 0;
+    node.double_literal = 0;
+    filter_->nodes_.push_back(node);
+    return filter_->nodes_.size() - 1;
+  }
+
+  static bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+  void SkipSpace() {
+    while (pos_ < text_.size() && IsSpace(text_[pos_])) {
+      pos_++;
+    }
+  }
+
+  int Expected(const char* what) {
+    ArrowErrorSet(error_, "Invalid filter '%s': expected %s at position %ld",
+                  text_.c_str(), what, static_cast<long>(pos_));
+    return EINVAL;
+  }
+};
+
+int SimpleCsvFilter::Parse(const std::string& expression,
+                           const std::vector<std::string>& names, ArrowError* error) {
+  nodes_.clear();
+  columns_.clear();
+  column_names_.clear();
+  root_ = -1;
+  return SimpleCsvFilterParser(expression, names, this, error).Parse();
+}
+
+int SimpleCsvFilter::Bind(const std::vector<SimpleCsvColumnType>& types,
+                          ArrowError* error) {
+  for (Node& node : nodes_) {
+    if (node.kind != NodeKind::COMPARE) {
+      continue;
+    }
+
+    SimpleCsvColumnType type = types[columns_[node.column]];
+    ArrowStringView literal = {node.literal.data(),
+                               static_cast<int64_t>(node.literal.size())};
+    bool ok = true;
+    switch (type) {
+      case SimpleCsvColumnType::STRING:
+      case SimpleCsvColumnType::DICTIONARY:
+        break;
+      case SimpleCsvColumnType::INT64:
+        ok = SimpleCsvParseInt64(literal, &node.int_literal);
+        break;
+      case SimpleCsvColumnType::DOUBLE:
+        ok = SimpleCsvParseDouble(literal, &node.double_literal);
+        break;
+      case SimpleCsvColumnType::BOOL: {
+        bool value;
+        ok = SimpleCsvParseBool(literal, &value);
+        node.int_literal = value;
+        break;
+      }
+      case SimpleCsvColumnType::DATE32: {
+        int32_t value;
+        ok = SimpleCsvParseDate32(literal, &value);
+        node.int_literal = value;
+        break;
+      }
+      case SimpleCsvColumnType::TIMESTAMP:
+        ok = SimpleCsvParseTimestamp(literal, &node.int_literal);
+        break;
+    }
+
+    if (!ok) {
+      ArrowErrorSet(error, "Can't compare column '%s' of type %s with '%s'",
+                    column_names_[node.column].c_str(), SimpleCsvColumnTypeName(type),
+                    node.literal.c_str());
+      return EINVAL;
+    }
+  }
+
+  return NANOARROW_OK;
+}
+
+void SimpleCsvFilter::Evaluate(const std::vector<SimpleCsvFilterColumn>& values,
+                               int64_t n_rows, uint8_t* selected) {
+  // There are fewer levels of nesting than nodes. Sizing the scratch masks up
+  // front keeps references to them valid during the recursion.
+  scratch_.resize(nodes_.size());
+  EvaluateNode(root_, values, n_rows, 0, selected);
+}
+
+void SimpleCsvFilter::EvaluateNode(int64_t i,
+                                   const std::vector<SimpleCsvFilterColumn>& values,
+                                   int64_t n_rows, int64_t depth, uint8_t* out) {
+  const Node& node = nodes_[i];
+  if (node.kind == NodeKind::COMPARE) {
+    Compare(node, values[node.column], n_rows, out);
+    return;
+  }
+
+  EvaluateNode(node.left, values, n_rows, depth + 1, out);
+
+  std::vector<uint8_t>& right = scratch_[depth];
+  right.resize(n_rows);
+  EvaluateNode(node.right, values, n_rows, depth + 1, right.data());
+
+  if (node.kind == NodeKind::AND) {
+    for (int64_t j = 0; j < n_rows; j++) {
+      out[j] &= right[j];
+    }
+  } else {
+    for (int64_t j = 0; j < n_rows; j++) {
+      out[j] |= right[j];
+    }
+  }
+}
+
+// Compares each value with a literal, writing 0 for nulls. Cmp is one of the
+// standard comparison function objects so that the loop can be vectorized.
+template <typename T, typename Cmp>
+static void SimpleCsvCompareEach(const T* values, const uint8_t* valid, T literal,
+                                 int64_t n_rows, uint8_t* out, Cmp cmp) {
+  for (int64_t i = 0; i < n_rows; i++) {
+    out[i] = valid[i] & static_cast<uint8_t>(cmp(values[i], literal));
+  }
+}
+
+// Three-way comparison of a string view with a literal, byte by byte
+static inline int SimpleCsvCompareStrings(ArrowStringView value,
+                                          const std::string& literal) {
+  int64_t size = std::min<int64_t>(value.size_bytes, literal.size());
+  int result = size > 0 ? memcmp(value.data, literal.data(), size) : 0;
+  if (result != 0) {
+    return result;
+  }
+
+  return value.size_bytes < static_cast<int64_t>(literal.size())
+             ? -1
+             : value.size_bytes > static_cast<int64_t>(literal.size());
+}
+
+template <typename T>
+static void SimpleCsvCompareValues(int op, const T* values, const uint8_t* valid,
+                                   T literal, int64_t n_rows, uint8_t* out) {
+  switch (op) {
+    case 0:
+      SimpleCsvCompareEach(values, valid, literal, n_rows, out, std::equal_to<T>());
+      break;
+    case 1:
+      SimpleCsvCompareEach(values, valid, literal, n_rows, out, std::not_equal_to<T>());
+      break;
+    case 2:
+      SimpleCsvCompareEach(values, valid, literal, n_rows, out, std::less<T>());
+      break;
+    case 3:
+      SimpleCsvCompareEach(values, valid, literal, n_rows, out, std::less_equal<T>());
+      break;
+    case 4:
+      SimpleCsvCompareEach(values, valid, literal, n_rows, out, std::greater<T>());
+      break;
+    default:
+      SimpleCsvCompareEach(values, valid, literal, n_rows, out, std::greater_equal<T>());
+      break;
+  }
+}
+
+void SimpleCsvFilter::Compare(const Node& node, const SimpleCsvFilterColumn& values,
+                              int64_t n_rows, uint8_t* out) {
+  // The order of the Op values matches SimpleCsvCompareValues()
+  int op = static_cast<int>(node.op);
+  const uint8_t* valid = values.valid.data();
+  switch (values.type) {
+    case SimpleCsvColumnType::STRING:
+    case SimpleCsvColumnType::DICTIONARY: {
+      // Turn each three-way comparison into the result of the operator
+      static const uint8_t kResults[6][3] = {{0, 1, 0}, {1, 0, 1}, {1, 0, 0},
+                                             {1, 1, 0}, {0, 0, 1}, {0, 1, 1}};
+      for (int64_t i = 0; i < n_rows; i++) {
+        int result = SimpleCsvCompareStrings(values.strings[i], node.literal);
+        out[i] = valid[i] & kResults[op][(result > 0) - (result < 0) + 1];
+      }
+      break;
+    }
+    case SimpleCsvColumnType::DOUBLE:
+      SimpleCsvCompareValues(op, values.doubles.data(), valid, node.double_literal,
+                             n_rows, out);
+      break;
+    default:
+      SimpleCsvCompareValues(op, values.ints.data(), valid, node.int_literal, n_rows,
+                             out);
+      break;
+  }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nanoarrow.h"
+#include "simple_csv_reader.h"
+
+// The values of one column for a group of rows, in the storage that a
+// SimpleCsvFilter compares: bool, int64, date32 and timestamp values as int64s,
+// doubles as doubles and strings (including dictionary-encoded ones) as views.
+struct SimpleCsvFilterColumn {
+  SimpleCsvColumnType type;
+  std::vector<int64_t> ints;
+  std::vector<double> doubles;
+  std::vector<ArrowStringView> strings;
+  // 1 for rows with a value, 0 for nulls
+  std::vector<uint8_t> valid;
+
+  // Empties the column for the next group of rows
+  void Clear();
+
+  // Appends a value, where value.data is nullptr for a null. Returns false if
+  // the value can't be converted to the column's type.
+  bool Append(ArrowStringView value);
+};
+
+// A predicate over the columns of a file made of comparisons between a column
+// and a literal (column op literal, where op is one of = != <> < <= > >=)
+// combined with AND, OR and parentheses, e.g.:
+//
+//   country = 'NZ' AND (amount >= 100 OR "order date" < 2020-01-01)
+//
+// Column names may be double-quoted and literals single-quoted ('' for a
+// quote); both must be quoted if they contain spaces, parentheses or operator
+// characters. A comparison with a null is false.
+//
+// Rows are filtered a group at a time: each comparison is evaluated over all
+// the values of its column into a byte mask, and masks are combined bytewise.
+class SimpleCsvFilter {
+ public:
+  // Parses an expression, resolving column names against the file's columns
+  int Parse(const std::string& expression, const std::vector<std::string>& names,
+            ArrowError* error);
+
+  // Converts literals to the types of the columns they are compared with.
+  // types has an entry for every column in the file.
+  int Bind(const std::vector<SimpleCsvColumnType>& types, ArrowError* error);
+
+  // The indices in the file of the columns used by the expression, which are
+  // the order of the columns passed to Evaluate()
+  const std::vector<int64_t>& columns() const { return columns_; }
+
+  // Sets selected[i] to 1 for the rows that pass and 0 for the others
+  void Evaluate(const std::vector<SimpleCsvFilterColumn>& values, int64_t n_rows,
+                uint8_t* selected);
+
+ private:
+  enum class NodeKind { COMPARE, AND, OR };
+  enum class Op { EQ, NE, LT, LE, GT, GE };
+
+  struct Node {
+    NodeKind kind;
+    // The operands of AND and OR
+    int64_t left;
+    int64_t right;
+    // For COMPARE, an index into columns_ and the literal as written and as
+    // converted by Bind()
+    int64_t column;
+    Op op;
+    std::string literal;
+    int64_t int_literal;
+    double double_literal;
+  };
+
+  std::vector<Node> nodes_;
+  int64_t root_;
+  std::vector<int64_t> columns_;
+  std::vector<std::string> column_names_;
+  // Masks for the intermediate results of Evaluate(), one per level of nesting
+  std::vector<std::vector<uint8_t>> scratch_;
+
+  void EvaluateNode(int64_t i, const std::vector<SimpleCsvFilterColumn>& values,
+                    int64_t n_rows, int64_t depth, uint8_t* out);
+  void Compare(const Node& node, const SimpleCsvFilterColumn& values, int64_t n_rows,
+               uint8_t* out);
+
+  friend class SimpleCsvFilterParser;
+};
@@ -0,0 +1,128 @@
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <utility>
+
+#include "simple_csv_index.h"
+#include "simple_csv_sidecar.h"
+
+// Indexes hold a magic string, a version and a byte order mark followed by
+// integers (in native byte order) and the identity of the file as a length and
+// its bytes
+static const char kSimpleCsvIndexMagic[] = "SCSVINDX";
+static constexpr int64_t kSimpleCsvIndexVersion = 1;
+static constexpr int64_t kSimpleCsvIndexByteOrder = 0x0102030405060708;
+
+std::string SimpleCsvIndexPath(const std::string& filename, const std::string& dir) {
+  return SimpleCsvSidecarPath(filename, dir, filename, ".scsvidx");
+}
+
+int SimpleCsvReadIndex(const std::string& path, const std::string& identity,
+                       SimpleCsvIndex* out, ArrowError* error) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input.is_open()) {
+    ArrowErrorSet(error, "Failed to open '%s'", path.c_str());
+    return ENOENT;
+  }
+
+  std::string data((std::istreambuf_iterator<char>(input)),
+                   std::istreambuf_iterator<char>());
+  size_t pos = sizeof(kSimpleCsvIndexMagic) - 1;
+  auto read_int = [&](int64_t* value) {
+    if (data.size() - pos < sizeof(int64_t)) {
+      return false;
+    }
+    memcpy(value, data.data() + pos, sizeof(int64_t));
+    pos += sizeof(int64_t);
+    return true;
+  };
+
+  SimpleCsvIndex index;
+  int64_t version, byte_order, identity_size, n_offsets;
+  bool ok = data.size() >= pos && data.compare(0, pos, kSimpleCsvIndexMagic) == 0 &&
+            read_int(&version) && version == kSimpleCsvIndexVersion &&
+            read_int(&byte_order) && byte_order == kSimpleCsvIndexByteOrder &&
+            read_int(&identity_size) && identity_size >= 0 &&
+            static_cast<uint64_t>(identity_size) <= data.size() - pos;
+  if (ok) {
+    index.identity = data.substr(pos, identity_size);
+    pos += identity_size;
+    ok = read_int(&index.interval) && index.interval > 0 && read_int(&index.data_start) &&
+         read_int(&index.n_records) && read_int(&n_offsets) && n_offsets >= 0 &&
+         static_cast<uint64_t>(n_offsets) == (data.size() - pos) / sizeof(int64_t) &&
+         (data.size() - pos) % sizeof(int64_t) == 0;
+  }
+
+  if (ok) {
+    index.offsets.resize(n_offsets);
+    for (int64_t& offset : index.offsets) {
+      read_int(&offset);
+    }
+  }
+
+  if (!ok) {
+    ArrowErrorSet(error, "Invalid index '%s'", path.c_str());
+    return EINVAL;
+  }
+
+  if (index.identity != identity) {
+    ArrowErrorSet(error, "Index '%s' is for another version of the file", path.c_str());
+    return EINVAL;
+  }
+
+  *out = std::move(index);
+  return NANOARROW_OK;
+}
+
+int SimpleCsvWriteIndex(const std::string& path, const SimpleCsvIndex& index,
+                        ArrowError* error) {
+  std::string data(kSimpleCsvIndexMagic);
+  auto write_int = [&data](int64_t value) {
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+
+  write_int(kSimpleCsvIndexVersion);
+  write_int(kSimpleCsvIndexByteOrder);
+  write_int(index.identity.size());
+  data += index.identity;
+  write_int(index.interval);
+  write_int(index.data_start);
+  write_int(index.n_records);
+  write_int(index.offsets.size());
+  for (int64_t offset : index.offsets) {
+    write_int(offset);
+  }
+
+  std::random_device random;
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", random(), random());
+  std::string temp_path = path + suffix;
+
+  std::ofstream output(temp_path, std::ios::binary | std::ios::trunc);
+  if (!output.is_open()) {
+    ArrowErrorSet(error, "Failed to create '%s'", temp_path.c_str());
+    return EIO;
+  }
+
+  output.write(data.data(), data.size());
+  output.close();
+  if (!output) {
+    std::remove(temp_path.c_str());
+    ArrowErrorSet(error, "Failed to write '%s'", temp_path.c_str());
+    return EIO;
+  }
+
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    int code = errno;
+    std::remove(temp_path.c_str());
+    ArrowErrorSet(error, "Failed to rename '%s' to '%s': %s", temp_path.c_str(),
+                  path.c_str(), strerror(code));
+    return EIO;
+  }
+
+  return NANOARROW_OK;
+}
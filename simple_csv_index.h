@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nanoarrow.h"
+
+// An index of the records of a file (the lines after the header that aren't
+// blank): the position of every interval-th record and the number of records.
+// Readers use it to start at a record without scanning the lines before it
+// and to split the file at record boundaries. Like sidecars (see
+// simple_csv_sidecar.h), indexes are kept in a file of their own that is only
+// valid for the version of the file given by identity (see
+// SimpleCsvFileIdentity()).
+struct SimpleCsvIndex {
+  std::string identity;
+  int64_t interval = 0;
+  // The position of the first line after the header
+  int64_t data_start = 0;
+  int64_t n_records = 0;
+  // offsets[k] is a position at which reading finds record k * interval next,
+  // after at most some blank lines
+  std::vector<int64_t> offsets;
+
+  // Adds a record that starts at position
+  void Add(int64_t position) {
+    if (n_records % interval == 0) {
+      offsets.push_back(position);
+    }
+    n_records++;
+  }
+};
+
+// The path of the index of filename: next to the file if dir is empty, and
+// otherwise in dir
+std::string SimpleCsvIndexPath(const std::string& filename, const std::string& dir);
+
+// Reads an index. Returns ENOENT if there is no index, and EINVAL if it is
+// invalid or was written for another version of the file.
+int SimpleCsvReadIndex(const std::string& path, const std::string& identity,
+                       SimpleCsvIndex* out, ArrowError* error);
+
+// Writes an index to a temporary file that then replaces the one at path
+int SimpleCsvWriteIndex(const std::string& path, const SimpleCsvIndex& index,
+                        ArrowError* error);
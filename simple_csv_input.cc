@@ -0,0 +1,388 @@
+
+#include <cerrno>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "simple_csv_input.h"
+
+#if defined(_WIN32)
+
+int SimpleCsvFileIdentity(const std::string& filename, std::string* out,
+                          ArrowError* error) {
+  ArrowErrorSet(error, "File identity is not supported on this platform");
+  return ENOTSUP;
+}
+
+#else
+
+int SimpleCsvFileIdentity(const std::string& filename, std::string* out,
+                          ArrowError* error) {
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0) {
+    ArrowErrorSet(error, "Failed to stat '%s': %s", filename.c_str(), strerror(errno));
+    return ENOENT;
+  }
+
+#if defined(__APPLE__)
+  int64_t mtime_ns = info.st_mtimespec.tv_nsec;
+#else
+  int64_t mtime_ns = info.st_mtim.tv_nsec;
+#endif
+
+  *out = std::to_string(info.st_dev) + ":" + std::to_string(info.st_ino) + ":" +
+         std::to_string(info.st_size) + ":" + std::to_string(info.st_mtime) + "." +
+         std::to_string(mtime_ns);
+  return NANOARROW_OK;
+}
+
+#endif
+
+int SimpleCsvFileSize(const std::string& filename, int64_t* size, ArrowError* error) {
+  std::ifstream input(filename, std::ios::binary | std::ios::ate);
+  if (!input.is_open()) {
+    ArrowErrorSet(error, "Failed to open '%s'", filename.c_str());
+    return ENOENT;
+  }
+
+  *size = static_cast<int64_t>(input.tellg());
+  return NANOARROW_OK;
+}
+
+SimpleCsvBufferedInput::SimpleCsvBufferedInput(const std::string& filename,
+                                               int64_t offset, int64_t block_size)
+    : filename_(filename),
+      offset_(offset),
+      input_(filename, std::ios::binary),
+      buffer_(block_size),
+      started_(false) {}
+
+int SimpleCsvBufferedInput::Next(SimpleCsvWindow* window, int64_t retain_from,
+                                 int64_t* bytes_read, ArrowError* error) {
+  if (!input_.is_open()) {
+    ArrowErrorSet(error, "Failed to open '%s'", filename_.c_str());
+    return ENOENT;
+  }
+
+  if (!started_) {
+    input_.seekg(offset_);
+    started_ = true;
+  }
+
+  // Move the bytes that are still needed to the front of the buffer, growing it
+  // if they already fill it completely.
+  int64_t keep = window->size - retain_from;
+  if (retain_from > 0) {
+    memmove(buffer_.data(), buffer_.data() + retain_from, keep);
+  } else if (keep == static_cast<int64_t>(buffer_.size())) {
+    buffer_.resize(buffer_.size() * 2);
+  }
+
+  input_.read(buffer_.data() + keep, buffer_.size() - keep);
+  if (input_.bad()) {
+    ArrowErrorSet(error, "Failed to read from '%s'", filename_.c_str());
+    return EIO;
+  }
+
+  *bytes_read = input_.gcount();
+  window->data = buffer_.data();
+  window->size = keep + *bytes_read;
+  return NANOARROW_OK;
+}
+
+#if defined(_WIN32)
+
+SimpleCsvMmapInput::SimpleCsvMmapInput(const std::string& filename, int64_t offset)
+    : filename_(filename), offset_(offset), data_(nullptr), size_(0), mapped_(false) {}
+
+SimpleCsvMmapInput::~SimpleCsvMmapInput() {}
+
+int SimpleCsvMmapInput::Next(SimpleCsvWindow* window, int64_t retain_from,
+                             int64_t* bytes_read, ArrowError* error) {
+  ArrowErrorSet(error, "Memory-mapped input is not supported on this platform");
+  return ENOTSUP;
+}
+
+#else
+
+SimpleCsvMmapInput::SimpleCsvMmapInput(const std::string& filename, int64_t offset)
+    : filename_(filename), offset_(offset), data_(nullptr), size_(0), mapped_(false) {}
+
+SimpleCsvMmapInput::~SimpleCsvMmapInput() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+}
+
+int SimpleCsvMmapInput::Next(SimpleCsvWindow* window, int64_t retain_from,
+                             int64_t* bytes_read, ArrowError* error) {
+  // The whole file is handed out on the first call
+  *bytes_read = 0;
+  if (mapped_) {
+    window->data += retain_from;
+    window->size -= retain_from;
+    return NANOARROW_OK;
+  }
+
+  int fd = open(filename_.c_str(), O_RDONLY);
+  if (fd == -1) {
+    ArrowErrorSet(error, "Failed to open '%s': %s", filename_.c_str(), strerror(errno));
+    return errno;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int code = errno;
+    close(fd);
+    ArrowErrorSet(error, "Failed to stat '%s': %s", filename_.c_str(), strerror(code));
+    return code;
+  }
+
+  size_ = st.st_size;
+  if (size_ > 0) {
+    void* addr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      int code = errno;
+      close(fd);
+      ArrowErrorSet(error, "Failed to map '%s': %s", filename_.c_str(), strerror(code));
+      return code;
+    }
+
+    data_ = static_cast<char*>(addr);
+    madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+
+  // The mapping keeps the file referenced
+  close(fd);
+  mapped_ = true;
+
+  int64_t offset = offset_ < size_ ? offset_ : size_;
+  window->data = data_ + offset;
+  window->size = size_ - offset;
+  *bytes_read = window->size;
+  return NANOARROW_OK;
+}
+
+#endif
+
+int SimpleCsvBlockInput::Next(SimpleCsvWindow* window, int64_t retain_from,
+                              int64_t* bytes_read, ArrowError* error) {
+  const char* retained = window->data + retain_from;
+  int64_t keep = window->size - retain_from;
+
+  Block* block;
+  NANOARROW_RETURN_NOT_OK(AcquireBlock(&block, error));
+  if (block == nullptr) {
+    window->data += retain_from;
+    window->size = keep;
+    *bytes_read = 0;
+    return NANOARROW_OK;
+  }
+
+  if (keep <= kHeadroom) {
+    char* start = block->data() - keep;
+    if (keep > 0) {
+      memcpy(start, retained, keep);
+    }
+    window->data = start;
+    window->size = keep + block->size;
+  } else {
+    // The retained bytes may already be in spill_
+    if (retained >= spill_.data() && retained < spill_.data() + spill_.size()) {
+      memmove(spill_.data(), retained, keep);
+      spill_.resize(keep + block->size);
+    } else {
+      spill_.resize(keep + block->size);
+      memcpy(spill_.data(), retained, keep);
+    }
+
+    memcpy(spill_.data() + keep, block->data(), block->size);
+    window->data = spill_.data();
+    window->size = spill_.size();
+  }
+
+  *bytes_read = block->size;
+
+  if (current_ != nullptr) {
+    ReleaseBlock(current_);
+    current_ = nullptr;
+  }
+
+  if (window->data == spill_.data()) {
+    ReleaseBlock(block);
+  } else {
+    current_ = block;
+  }
+
+  return NANOARROW_OK;
+}
+
+SimpleCsvReadaheadInput::SimpleCsvReadaheadInput(
+    std::unique_ptr<SimpleCsvBlockSource> source, int64_t n_blocks, int64_t block_size)
+    : source_(std::move(source)),
+      started_(false),
+      finished_(false),
+      stop_(false),
+      code_(NANOARROW_OK) {
+  for (int64_t i = 0; i < n_blocks; i++) {
+    blocks_.push_back(std::unique_ptr<Block>(new Block(block_size)));
+    free_.push_back(blocks_.back().get());
+  }
+}
+
+SimpleCsvReadaheadInput::~SimpleCsvReadaheadInput() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+int SimpleCsvReadaheadInput::AcquireBlock(Block** block, ArrowError* error) {
+  if (!started_) {
+    NANOARROW_RETURN_NOT_OK(source_->Open(error));
+    thread_ = std::thread(&SimpleCsvReadaheadInput::Run, this);
+    started_ = true;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [&] { return !filled_.empty() || finished_; });
+  if (!filled_.empty()) {
+    *block = filled_.front();
+    filled_.pop_front();
+    return NANOARROW_OK;
+  }
+
+  if (code_ != NANOARROW_OK) {
+    ArrowErrorSet(error, "%s", thread_error_.message);
+    return code_;
+  }
+
+  *block = nullptr;
+  return NANOARROW_OK;
+}
+
+void SimpleCsvReadaheadInput::ReleaseBlock(Block* block) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(block);
+  }
+  cv_.notify_all();
+}
+
+void SimpleCsvReadaheadInput::Run() {
+  while (true) {
+    Block* block;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [&] { return stop_ || !free_.empty(); });
+      if (stop_) {
+        return;
+      }
+
+      block = free_.front();
+      free_.pop_front();
+    }
+
+    int code = source_->Read(block->data(), block->capacity(), &block->size,
+                             &thread_error_);
+    bool finished = code != NANOARROW_OK || block->size == 0;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (finished) {
+        code_ = code;
+        finished_ = true;
+        free_.push_back(block);
+      } else {
+        filled_.push_back(block);
+      }
+    }
+    cv_.notify_all();
+
+    if (finished) {
+      return;
+    }
+  }
+}
+
+#if defined(_WIN32)
+
+SimpleCsvPreadSource::SimpleCsvPreadSource(const std::string& filename, int64_t offset,
+                                           int64_t readahead_bytes)
+    : filename_(filename), offset_(offset), readahead_bytes_(readahead_bytes), fd_(-1) {}
+
+SimpleCsvPreadSource::~SimpleCsvPreadSource() {}
+
+int SimpleCsvPreadSource::Open(ArrowError* error) {
+  ArrowErrorSet(error, "Read-ahead input is not supported on this platform");
+  return ENOTSUP;
+}
+
+int SimpleCsvPreadSource::Read(char* out, int64_t capacity, int64_t* bytes_read,
+                               ArrowError* error) {
+  return ENOTSUP;
+}
+
+#else
+
+SimpleCsvPreadSource::SimpleCsvPreadSource(const std::string& filename, int64_t offset,
+                                           int64_t readahead_bytes)
+    : filename_(filename), offset_(offset), readahead_bytes_(readahead_bytes), fd_(-1) {}
+
+SimpleCsvPreadSource::~SimpleCsvPreadSource() {
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+int SimpleCsvPreadSource::Open(ArrowError* error) {
+  fd_ = open(filename_.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    ArrowErrorSet(error, "Failed to open '%s': %s", filename_.c_str(), strerror(errno));
+    return errno;
+  }
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+  posix_fadvise(fd_, offset_, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  return NANOARROW_OK;
+}
+
+int SimpleCsvPreadSource::Read(char* out, int64_t capacity, int64_t* bytes_read,
+                               ArrowError* error) {
+#if defined(POSIX_FADV_WILLNEED)
+  // Ask for the blocks after this one to be read into the page cache while we
+  // wait for this one
+  posix_fadvise(fd_, offset_ + capacity, readahead_bytes_, POSIX_FADV_WILLNEED);
+#endif
+
+  *bytes_read = 0;
+  while (*bytes_read < capacity) {
+    ssize_t n = pread(fd_, out + *bytes_read, capacity - *bytes_read, offset_);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    } else if (n == -1) {
+      ArrowErrorSet(error, "Failed to read from '%s': %s", filename_.c_str(),
+                    strerror(errno));
+      return errno;
+    } else if (n == 0) {
+      break;
+    }
+
+    *bytes_read += n;
+    offset_ += n;
+  }
+
+  return NANOARROW_OK;
+}
+
+#endif
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nanoarrow.h"
+
+// The region of input bytes that a SimpleCsvScanner is currently looking at.
+// The scanner may modify bytes inside the window (e.g., to unescape a field in
+// place).
+struct SimpleCsvWindow {
+  char* data;
+  int64_t size;
+};
+
+// A source of bytes for the SimpleCsvScanner. Inputs are constructed with the
+// byte offset in the file at which to start reading.
+class SimpleCsvInput {
+ public:
+  virtual ~SimpleCsvInput() {}
+
+  // Replaces *window with one that starts with the bytes
+  // [retain_from, window->size) of the previous window (which the scanner still
+  // needs) followed by the next bytes of the input. Sets *bytes_read to the
+  // number of new bytes, which is 0 at the end of the input.
+  virtual int Next(SimpleCsvWindow* window, int64_t retain_from, int64_t* bytes_read,
+                   ArrowError* error) = 0;
+};
+
+// Reads fixed-size blocks from a std::ifstream into a reusable buffer
+class SimpleCsvBufferedInput : public SimpleCsvInput {
+ public:
+  static constexpr int64_t kDefaultBlockSize = 1024 * 1024;
+
+  SimpleCsvBufferedInput(const std::string& filename, int64_t offset = 0,
+                         int64_t block_size = kDefaultBlockSize);
+
+  int Next(SimpleCsvWindow* window, int64_t retain_from, int64_t* bytes_read,
+           ArrowError* error) override;
+
+ private:
+  std::string filename_;
+  int64_t offset_;
+  std::ifstream input_;
+  std::vector<char> buffer_;
+  bool started_;
+};
+
+// Maps the whole file into memory so that fields can be viewed in place without
+// copying them out of the page cache. The mapping is private and writable so
+// that the rare in-place modifications made by the scanner never reach the file.
+class SimpleCsvMmapInput : public SimpleCsvInput {
+ public:
+  explicit SimpleCsvMmapInput(const std::string& filename, int64_t offset = 0);
+  ~SimpleCsvMmapInput() override;
+
+  int Next(SimpleCsvWindow* window, int64_t retain_from, int64_t* bytes_read,
+           ArrowError* error) override;
+
+ private:
+  std::string filename_;
+  int64_t offset_;
+  char* data_;
+  int64_t size_;
+  bool mapped_;
+};
+
+// An input that hands out a sequence of fixed-size blocks that are filled by
+// some other agent (e.g., a background thread) while the scanner works on the
+// previous one. Each block has some headroom in front of its data so that the
+// unfinished line at the end of one block can usually be copied in front of
+// the next without copying the whole block. The scanner keeps its block until
+// the next one has been acquired, so inputs need at least two blocks.
+class SimpleCsvBlockInput : public SimpleCsvInput {
+ public:
+  static constexpr int64_t kHeadroom = 64 * 1024;
+
+  struct Block {
+    explicit Block(int64_t capacity) : buffer(kHeadroom + capacity), size(0) {}
+    char* data() { return buffer.data() + kHeadroom; }
+    int64_t capacity() const { return buffer.size() - kHeadroom; }
+
+    std::vector<char> buffer;
+    int64_t size;
+  };
+
+  SimpleCsvBlockInput() : current_(nullptr) {}
+
+  int Next(SimpleCsvWindow* window, int64_t retain_from, int64_t* bytes_read,
+           ArrowError* error) override;
+
+ protected:
+  // Waits for the next block of the input. Sets *block to nullptr at the end
+  // of the input.
+  virtual int AcquireBlock(Block** block, ArrowError* error) = 0;
+
+  // Gives back a block that the scanner no longer needs
+  virtual void ReleaseBlock(Block* block) = 0;
+
+ private:
+  // The block that the current window points into, if any
+  Block* current_;
+  // Holds the window when the retained bytes don't fit in a block's headroom
+  std::vector<char> spill_;
+};
+
+// Produces the bytes of a file in order for a SimpleCsvReadaheadInput. Read()
+// is called from the input's background thread.
+class SimpleCsvBlockSource {
+ public:
+  virtual ~SimpleCsvBlockSource() {}
+  virtual int Open(ArrowError* error) = 0;
+
+  // Reads up to capacity bytes into out. Sets *bytes_read to 0 at the end of
+  // the input.
+  virtual int Read(char* out, int64_t capacity, int64_t* bytes_read,
+                   ArrowError* error) = 0;
+};
+
+// Reads a file with pread(), hinting the kernel to read ahead of us with
+// posix_fadvise()
+class SimpleCsvPreadSource : public SimpleCsvBlockSource {
+ public:
+  SimpleCsvPreadSource(const std::string& filename, int64_t offset,
+                       int64_t readahead_bytes);
+  ~SimpleCsvPreadSource() override;
+
+  int Open(ArrowError* error) override;
+  int Read(char* out, int64_t capacity, int64_t* bytes_read, ArrowError* error) override;
+
+ private:
+  std::string filename_;
+  int64_t offset_;
+  int64_t readahead_bytes_;
+  int fd_;
+};
+
+// Fills a ring of reusable blocks from a SimpleCsvBlockSource on a background
+// thread so that reading the next blocks overlaps with parsing the current one.
+class SimpleCsvReadaheadInput : public SimpleCsvBlockInput {
+ public:
+  static constexpr int64_t kDefaultBlocks = 4;
+
+  SimpleCsvReadaheadInput(std::unique_ptr<SimpleCsvBlockSource> source,
+                          int64_t n_blocks = kDefaultBlocks,
+                          int64_t block_size = SimpleCsvBufferedInput::kDefaultBlockSize);
+  ~SimpleCsvReadaheadInput() override;
+
+ protected:
+  int AcquireBlock(Block** block, ArrowError* error) override;
+  void ReleaseBlock(Block* block) override;
+
+ private:
+  std::unique_ptr<SimpleCsvBlockSource> source_;
+  std::vector<std::unique_ptr<Block>> blocks_;
+  bool started_;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Block*> free_;
+  std::deque<Block*> filled_;
+  bool finished_;
+  bool stop_;
+  int code_;
+  ArrowError thread_error_;
+
+  void Run();
+};
+
+// Returns the size of a file in bytes
+int SimpleCsvFileSize(const std::string& filename, int64_t* size, ArrowError* error);
+
+// Identifies the current version of a file by its device, inode, size and
+// modification time. Not supported on Windows.
+int SimpleCsvFileIdentity(const std::string& filename, std::string* out,
+                          ArrowError* error);
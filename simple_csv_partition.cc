@@ -0,0 +1,194 @@
+
+#include <cerrno>
+#include <cstring>
+
+#include "simple_csv_partition.h"
+
+// Descriptors start with a magic string and a version, followed by integers
+// (8 bytes, little endian) and strings (an integer length then the bytes)
+static const char kSimpleCsvPartitionMagic[] = "SCSVPART";
+static constexpr int64_t kSimpleCsvPartitionVersion = 1;
+
+class SimpleCsvPartitionWriter {
+ public:
+  explicit SimpleCsvPartitionWriter(std::string* out) : out_(out) {}
+
+  void Int(int64_t value) {
+    uint64_t bits = static_cast<uint64_t>(value);
+    for (int i = 0; i < 8; i++) {
+      out_->push_back(static_cast<char>(bits >> (8 * i)));
+    }
+  }
+
+  void String(const std::string& value) {
+    Int(value.size());
+    out_->append(value);
+  }
+
+  void Strings(const std::vector<std::string>& values) {
+    Int(values.size());
+    for (const std::string& value : values) {
+      String(value);
+    }
+  }
+
+ private:
+  std::string* out_;
+};
+
+class SimpleCsvPartitionParser {
+ public:
+  SimpleCsvPartitionParser(const uint8_t* data, size_t size)
+      : data_(data), size_(size), pos_(0) {}
+
+  bool Int(int64_t* out) {
+    if (size_ - pos_ < 8) {
+      return false;
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; i++) {
+      bits |= static_cast<uint64_t>(data_[pos_ + i]) << (8 * i);
+    }
+    pos_ += 8;
+    *out = static_cast<int64_t>(bits);
+    return true;
+  }
+
+  bool String(std::string* out) {
+    int64_t size;
+    if (!Int(&size) || size < 0 || static_cast<uint64_t>(size) > size_ - pos_) {
+      return false;
+    }
+
+    out->assign(reinterpret_cast<const char*>(data_ + pos_), size);
+    pos_ += size;
+    return true;
+  }
+
+  bool Strings(std::vector<std::string>* out) {
+    int64_t n;
+    if (!Int(&n) || n < 0 || static_cast<uint64_t>(n) > size_ - pos_) {
+      return false;
+    }
+
+    out->resize(n);
+    for (std::string& value : *out) {
+      if (!String(&value)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool Magic() {
+    size_t size = sizeof(kSimpleCsvPartitionMagic) - 1;
+    if (size_ - pos_ < size ||
+        memcmp(data_ + pos_, kSimpleCsvPartitionMagic, size) != 0) {
+      return false;
+    }
+
+    pos_ += size;
+    return true;
+  }
+
+  bool finished() const { return pos_ == size_; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_;
+};
+
+uint64_t SimpleCsvPartition::ComputeFingerprint() const {
+  // FNV-1a over the names and types of the columns
+  uint64_t hash = 14695981039346656037ULL;
+  auto update = [&hash](const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      hash ^= static_cast<uint8_t>(data[i]);
+      hash *= 1099511628211ULL;
+    }
+  };
+
+  for (const SimpleCsvPartitionColumn& column : columns) {
+    const char* type = SimpleCsvColumnTypeName(column.type);
+    update(column.name.data(), column.name.size() + 1);
+    update(type, strlen(type) + 1);
+    update(column.large_string ? "L" : "S", 1);
+  }
+
+  return hash;
+}
+
+std::string SimpleCsvPartition::Serialize() const {
+  std::string out(kSimpleCsvPartitionMagic);
+  SimpleCsvPartitionWriter writer(&out);
+  writer.Int(kSimpleCsvPartitionVersion);
+  writer.String(filename);
+  writer.Int(file_size);
+  writer.String(identity);
+  writer.Int(begin);
+  writer.Int(end);
+
+  writer.Int(columns.size());
+  for (const SimpleCsvPartitionColumn& column : columns) {
+    writer.String(column.name);
+    writer.String(SimpleCsvColumnTypeName(column.type));
+    writer.Int(column.large_string);
+  }
+  writer.Int(static_cast<int64_t>(fingerprint));
+
+  writer.Strings(projection);
+  writer.Strings(null_values);
+  writer.String(filter);
+  writer.Int(limit);
+  writer.Int(offset);
+  return out;
+}
+
+int SimpleCsvPartition::Deserialize(const uint8_t* data, size_t size, ArrowError* error) {
+  SimpleCsvPartitionParser parser(data, size);
+  int64_t version;
+  if (!parser.Magic() || !parser.Int(&version)) {
+    ArrowErrorSet(error, "Invalid partition descriptor");
+    return EINVAL;
+  }
+
+  if (version != kSimpleCsvPartitionVersion) {
+    ArrowErrorSet(error, "Unsupported partition descriptor version %ld", (long)version);
+    return ENOTSUP;
+  }
+
+  int64_t n_columns;
+  bool ok = parser.String(&filename) && parser.Int(&file_size) &&
+            parser.String(&identity) && parser.Int(&begin) && parser.Int(&end) &&
+            parser.Int(&n_columns) && n_columns >= 0 &&
+            n_columns <= static_cast<int64_t>(size);
+  if (ok) {
+    columns.resize(n_columns);
+    for (SimpleCsvPartitionColumn& column : columns) {
+      std::string type;
+      int64_t large_string;
+      ok = ok && parser.String(&column.name) && parser.String(&type) &&
+           SimpleCsvColumnTypeFromName(type, &column.type) && parser.Int(&large_string);
+      column.large_string = ok && large_string != 0;
+    }
+  }
+
+  int64_t fingerprint_bits;
+  ok = ok && parser.Int(&fingerprint_bits) && parser.Strings(&projection) &&
+       parser.Strings(&null_values) && parser.String(&filter) && parser.Int(&limit) &&
+       parser.Int(&offset) && parser.finished();
+  if (!ok) {
+    ArrowErrorSet(error, "Invalid partition descriptor");
+    return EINVAL;
+  }
+
+  fingerprint = static_cast<uint64_t>(fingerprint_bits);
+  if (fingerprint != ComputeFingerprint()) {
+    ArrowErrorSet(error, "Invalid partition descriptor: schema fingerprint mismatch");
+    return EINVAL;
+  }
+
+  return NANOARROW_OK;
+}
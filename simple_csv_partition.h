@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nanoarrow.h"
+#include "simple_csv_reader.h"
+
+// A column of the file a partition was planned from
+struct SimpleCsvPartitionColumn {
+  std::string name;
+  SimpleCsvColumnType type;
+  bool large_string;
+};
+
+// A slice of a file that can be read on its own, possibly in another process:
+// the records that start in [begin, end), where begin is the start of a record.
+// The file's schema is included so that readers don't infer it again, along
+// with the options that decide which rows and columns are returned.
+struct SimpleCsvPartition {
+  std::string filename;
+  // The size and identity (see SimpleCsvFileIdentity()) of the file when it was
+  // partitioned, to detect changes. The identity is empty where it isn't
+  // supported.
+  int64_t file_size = 0;
+  std::string identity;
+  int64_t begin = 0;
+  int64_t end = 0;
+  std::vector<SimpleCsvPartitionColumn> columns;
+  // Identifies the schema: partitions with the same fingerprint have the same
+  // columns and types
+  uint64_t fingerprint = 0;
+
+  std::vector<std::string> projection;
+  std::vector<std::string> null_values;
+  std::string filter;
+  int64_t limit = -1;
+  int64_t offset = 0;
+
+  // Computes the fingerprint of columns
+  uint64_t ComputeFingerprint() const;
+
+  // Serializes the partition as an opaque descriptor
+  std::string Serialize() const;
+
+  // Reads a descriptor made by Serialize()
+  int Deserialize(const uint8_t* data, size_t size, ArrowError* error);
+};
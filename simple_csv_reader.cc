@@ -1,177 +1,2890 @@
 
+#include <algorithm>
 #include <cerrno>
-#include <fstream>
-#include <sstream>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "nanoarrow.hpp"
+#include "simple_csv_convert.h"
+#include "simple_csv_decompress.h"
+#include "simple_csv_filter.h"
+#include "simple_csv_index.h"
+#include "simple_csv_input.h"
+#include "simple_csv_partition.h"
 #include "simple_csv_reader.h"
+#include "simple_csv_sidecar.h"
+#include "simple_csv_simd.h"
+#include "simple_csv_uring.h"
 
 enum class ScanResult { UNINITIALIZED, FIELD_SEP, LINE_SEP, DONE };
 
+// The field values that are read as null. Most fields can be ruled out by
+// their length alone.
+class SimpleCsvNullTokens {
+ public:
+  explicit SimpleCsvNullTokens(const std::vector<std::string>& tokens)
+      : tokens_(tokens), lengths_(0), has_long_(false) {
+    for (const std::string& token : tokens_) {
+      if (token.size() < 64) {
+        lengths_ |= uint64_t(1) << token.size();
+      } else {
+        has_long_ = true;
+      }
+    }
+  }
+
+  bool Matches(const char* data, int64_t size) const {
+    if (size < 64 ? ((lengths_ >> size) & 1) == 0 : !has_long_) {
+      return false;
+    }
+
+    for (const std::string& token : tokens_) {
+      if (static_cast<int64_t>(token.size()) == size &&
+          memcmp(token.data(), data, size) == 0) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+ private:
+  std::vector<std::string> tokens_;
+  // Bit i is set if there is a token of length i
+  uint64_t lengths_;
+  bool has_long_;
+};
+
+// Pulls bytes from a SimpleCsvInput and hands out fields as views into the
+// input's window. The views returned by ReadLine() remain valid until the next
+// call to ReadLine(): when a line spans the end of the window, the input is
+// asked to retain the partial line at the front of the next window.
+//
+// Field boundaries are found by classifying the window 64 bytes at a time into
+// bitmasks of structural characters (see simple_csv_simd.h) and walking the set
+// bits rather than testing each byte. Delimiters and newlines between double
+// quotes are masked out using a prefix-XOR over the quote positions, so quoted
+// fields (RFC 4180) never need a per-byte state machine.
 class SimpleCsvScanner {
  public:
-  SimpleCsvScanner(const std::string& filename) : input_(filename, std::ios::binary) {}
+  // offset is the position in the file at which input starts reading
+  SimpleCsvScanner(std::unique_ptr<SimpleCsvInput> input, int64_t offset)
+      : input_(std::move(input)),
+        window_{nullptr, 0},
+        window_offset_(offset),
+        eof_(false),
+        line_start_(0),
+        mark_(-1),
+        pos_(0),
+        chunk_start_(0),
+        chunk_end_(0),
+        structurals_(0),
+        newlines_(0),
+        inside_quotes_(0) {}
+
+  // Appends the fields of the next line to values. Unquoted fields that match
+  // one of null_tokens (if given) are returned with a data pointer of nullptr.
+  // If wanted is given, fields whose entry is zero are returned as they appear
+  // in the input, without unquoting or matching null tokens.
+  int ReadLine(std::vector<ArrowStringView>* values, ScanResult* result,
+               ArrowError* error, const SimpleCsvNullTokens* null_tokens = nullptr,
+               const std::vector<char>* wanted = nullptr) {
+    bounds_.clear();
+    line_start_ = pos_;
+    // Relative to line_start_ so that it survives a call to Refill()
+    int64_t field_start = 0;
+
+    while (true) {
+      if (structurals_ == 0) {
+        if (chunk_end_ < window_.size) {
+          ClassifyNextChunk();
+          continue;
+        }
+
+        int64_t bytes_read;
+        NANOARROW_RETURN_NOT_OK(Refill(&bytes_read, error));
+        if (bytes_read > 0) {
+          continue;
+        }
+
+        pos_ = window_.size;
+        *result = ScanResult::DONE;
+        break;
+      }
+
+      int64_t pos = chunk_start_ + SimpleCsvLowestBit(structurals_);
+      structurals_ &= structurals_ - 1;
+
+      *result = window_.data[pos] == ',' ? ScanResult::FIELD_SEP : ScanResult::LINE_SEP;
+      bounds_.push_back(field_start);
+      bounds_.push_back(pos - line_start_);
+      pos_ = pos + 1;
+      field_start = pos_ - line_start_;
+
+      if (*result == ScanResult::LINE_SEP) {
+        break;
+      }
+    }
+
+    if (*result == ScanResult::DONE) {
+      bounds_.push_back(field_start);
+      bounds_.push_back(pos_ - line_start_);
+    }
+
+    // Accept \r\n line endings
+    char* line = window_.data + line_start_;
+    int64_t& line_end = bounds_.back();
+    if (line_end > bounds_[bounds_.size() - 2] && line[line_end - 1] == '\r') {
+      line_end--;
+    }
+
+    for (size_t i = 0; i < bounds_.size(); i += 2) {
+      char* data = line + bounds_[i];
+      int64_t size = bounds_[i + 1] - bounds_[i];
+      if (wanted != nullptr && i / 2 < wanted->size() && !(*wanted)[i / 2]) {
+        values->push_back({data, size});
+      } else if (null_tokens != nullptr && (size == 0 || data[0] != '"') &&
+                 null_tokens->Matches(data, size)) {
+        values->push_back({nullptr, 0});
+      } else {
+        values->push_back(Unquote(data, size));
+      }
+    }
+
+    return NANOARROW_OK;
+  }
+
+  // Skips up to n lines that aren't blank (see blank()), looking only at
+  // newlines: no field boundaries are recorded and no fields are returned.
+  // skipped is set to the number of lines skipped, which is less than n only if
+  // the input ended.
+  int SkipLines(int64_t n, int64_t* skipped, ScanResult* result, ArrowError* error) {
+    *skipped = 0;
+    *result = ScanResult::LINE_SEP;
+    line_start_ = pos_;
+
+    while (*skipped < n) {
+      uint64_t newlines = structurals_ & newlines_;
+      if (newlines == 0) {
+        structurals_ = 0;
+        if (chunk_end_ < window_.size) {
+          ClassifyNextChunk();
+          continue;
+        }
+
+        // Only the current line has to be kept in the window
+        line_start_ = pos_;
+        int64_t bytes_read;
+        NANOARROW_RETURN_NOT_OK(Refill(&bytes_read, error));
+        if (bytes_read > 0) {
+          continue;
+        }
+
+        // The last line doesn't have to end in a newline
+        int64_t size = window_.size - pos_;
+        if (size > 1 || (size == 1 && window_.data[pos_] != '\r')) {
+          (*skipped)++;
+        }
+        pos_ = window_.size;
+        *result = ScanResult::DONE;
+        break;
+      }
+
+      // Consume the structural characters up to and including the newline
+      uint64_t newline = newlines & (0 - newlines);
+      structurals_ &= ~(newline ^ (newline - 1));
+      int64_t pos = chunk_start_ + SimpleCsvLowestBit(newlines);
+      int64_t size = pos - pos_;
+      if (size > 1 || (size == 1 && window_.data[pos_] != '\r')) {
+        (*skipped)++;
+      }
+      pos_ = pos + 1;
+    }
+
+    line_start_ = pos_;
+    return NANOARROW_OK;
+  }
+
+  // Skips lines until the next one starts at or after target, a position in
+  // the file, looking only at newlines like SkipLines(). Stops at the end of
+  // the input if no line starts there.
+  int SkipTo(int64_t target, ScanResult* result, ArrowError* error) {
+    *result = ScanResult::LINE_SEP;
+    line_start_ = pos_;
+
+    while (position() < target) {
+      uint64_t newlines = structurals_ & newlines_;
+      if (newlines != 0) {
+        // Only a newline at or after target - 1 ends the line before target
+        int64_t first = target - 1 - window_offset_ - chunk_start_;
+        uint64_t after = newlines;
+        if (first >= 64) {
+          after = 0;
+        } else if (first > 0) {
+          after &= ~((uint64_t(1) << first) - 1);
+        }
+
+        if (after != 0) {
+          uint64_t newline = after & (0 - after);
+          structurals_ &= ~(newline ^ (newline - 1));
+          pos_ = chunk_start_ + SimpleCsvLowestBit(after) + 1;
+          break;
+        }
+
+        pos_ = chunk_start_ + SimpleCsvHighestBit(newlines) + 1;
+      }
+
+      structurals_ = 0;
+      if (chunk_end_ < window_.size) {
+        ClassifyNextChunk();
+        continue;
+      }
+
+      line_start_ = pos_;
+      int64_t bytes_read;
+      NANOARROW_RETURN_NOT_OK(Refill(&bytes_read, error));
+      if (bytes_read > 0) {
+        continue;
+      }
+
+      pos_ = window_.size;
+      *result = ScanResult::DONE;
+      break;
+    }
+
+    line_start_ = pos_;
+    return NANOARROW_OK;
+  }
+
+  // Counts the lines from here to the end of the input that aren't blank (see
+  // blank()). Newlines are counted a chunk at a time from the classifier's
+  // masks; only a newline that directly follows a carriage return at the start
+  // of a line needs its bytes looked at.
+  int CountLines(int64_t* n_lines, ArrowError* error) {
+    *n_lines = 0;
+
+    while (true) {
+      uint64_t newlines = structurals_ & newlines_;
+      structurals_ = 0;
+      if (newlines != 0) {
+        // The start of each line, as a bit in this chunk (if it's in it)
+        int64_t start = pos_ - chunk_start_;
+        uint64_t starts = newlines << 1;
+        if (start >= 0) {
+          starts |= uint64_t(1) << start;
+        }
+
+        // Newlines that start a line are blank lines, as are those that follow
+        // a carriage return that starts a line
+        uint64_t blank = newlines & starts;
+        uint64_t after_cr = newlines & ~blank & ((starts << 1) | (start == -1 ? 1 : 0));
+        int64_t n_blank = SimpleCsvPopcount(blank);
+        while (after_cr != 0) {
+          n_blank +=
+              window_.data[chunk_start_ + SimpleCsvLowestBit(after_cr) - 1] == '\r';
+          after_cr &= after_cr - 1;
+        }
+
+        *n_lines += SimpleCsvPopcount(newlines) - n_blank;
+        pos_ = chunk_start_ + SimpleCsvHighestBit(newlines) + 1;
+      }
+
+      if (chunk_end_ < window_.size) {
+        ClassifyNextChunk();
+        continue;
+      }
+
+      line_start_ = pos_;
+      int64_t bytes_read;
+      NANOARROW_RETURN_NOT_OK(Refill(&bytes_read, error));
+      if (bytes_read > 0) {
+        continue;
+      }
+
+      // The last line doesn't have to end in a newline
+      int64_t size = window_.size - pos_;
+      if (size > 1 || (size == 1 && window_.data[pos_] != '\r')) {
+        (*n_lines)++;
+      }
+      pos_ = window_.size;
+      line_start_ = pos_;
+      return NANOARROW_OK;
+    }
+  }
+
+  // Releases the input once no more lines will be read. Views returned by
+  // ReadLine() are no longer valid afterwards.
+  void Close() {
+    input_.reset();
+    window_offset_ += pos_;
+    window_ = {nullptr, 0};
+    eof_ = true;
+    line_start_ = pos_ = 0;
+    mark_ = -1;
+    ResetChunk();
+  }
+
+  // Skips to the start of the next line when starting to scan at an arbitrary
+  // position in the file. Whether that position is inside a quoted field is
+  // guessed from the first quote that looks like it opens or closes a field
+  // (i.e., has a delimiter or newline on exactly one side). The guess can be
+  // wrong, so callers must verify the result if it matters.
+  int SkipPartialLine(ArrowError* error) {
+    // Make sure the lookahead is in the window
+    line_start_ = pos_;
+    int64_t bytes_read = 1;
+    while (window_.size - pos_ < kLineStartLookahead && bytes_read > 0) {
+      NANOARROW_RETURN_NOT_OK(Refill(&bytes_read, error));
+    }
+
+    const char* data = window_.data;
+    int64_t end = window_.size;
+    bool inside = false;
+    int64_t n_quotes = 0;
+    for (int64_t i = pos_; i < end; i++) {
+      if (data[i] != '"') {
+        continue;
+      }
+
+      // Escaped quotes and empty fields don't tell us anything
+      if (i + 1 < end && data[i + 1] == '"') {
+        i++;
+        n_quotes += 2;
+        continue;
+      }
+
+      bool after_boundary = i > pos_ && (data[i - 1] == ',' || data[i - 1] == '\n');
+      bool before_boundary = i + 1 == end || data[i + 1] == ',' || data[i + 1] == '\n' ||
+                             data[i + 1] == '\r';
+      if (after_boundary && !before_boundary) {
+        inside = n_quotes % 2 == 1;
+        break;
+      } else if (before_boundary && !after_boundary) {
+        inside = n_quotes % 2 == 0;
+        break;
+      }
+
+      n_quotes++;
+    }
+
+    for (int64_t i = pos_; i < end; i++) {
+      if (data[i] == '"') {
+        inside = !inside;
+      } else if (data[i] == '\n' && !inside) {
+        pos_ = i + 1;
+        ResetChunk();
+        return NANOARROW_OK;
+      }
+    }
+
+    // The lookahead is inside one long quoted field (or the rest of the file
+    // is one line), so fall back to the next newline
+    while (true) {
+      const void* newline = memchr(window_.data + pos_, '\n', window_.size - pos_);
+      if (newline != nullptr) {
+        pos_ = static_cast<const char*>(newline) - window_.data + 1;
+        break;
+      }
+
+      pos_ = window_.size;
+      NANOARROW_RETURN_NOT_OK(Refill(&bytes_read, error));
+      if (bytes_read == 0) {
+        break;
+      }
+    }
+
+    ResetChunk();
+    return NANOARROW_OK;
+  }
+
+  // The position in the file of the start of the next line
+  int64_t position() const { return window_offset_ + pos_; }
+
+  // True if the line last read by ReadLine() is blank: empty but for a
+  // carriage return. SkipLines() and CountLines() skip the same lines, so a
+  // line that only holds a quoted empty field ("") is not blank.
+  bool blank() const { return bounds_.size() == 2 && bounds_[0] == bounds_[1]; }
+
+  // Keeps the lines read after a call to Mark() in the window until Unmark(),
+  // so that the views returned for all of them remain valid as long as they
+  // are taken relative to marked_data(), which moves when the window does.
+  void Mark() { mark_ = pos_; }
+  void Unmark() { mark_ = -1; }
+  const char* marked_data() const { return window_.data + mark_; }
+  int64_t marked_size() const { return pos_ - mark_; }
+
+ private:
+  static constexpr int64_t kLineStartLookahead = 64 * 1024;
+
+  std::unique_ptr<SimpleCsvInput> input_;
+  SimpleCsvWindow window_;
+  // The position in the file of window_.data[0]
+  int64_t window_offset_;
+  bool eof_;
+  // Field boundaries for the current line as (start, end) pairs relative to
+  // line_start_, which stay valid when the line is moved by Refill().
+  std::vector<int64_t> bounds_;
+  int64_t line_start_;
+  // The start of the marked lines, or -1
+  int64_t mark_;
+  int64_t pos_;
+
+  // The most recently classified chunk of the window and the structural
+  // characters in it that have not yet been consumed.
+  int64_t chunk_start_;
+  int64_t chunk_end_;
+  uint64_t structurals_;
+  // The newlines among structurals_
+  uint64_t newlines_;
+  // All ones if chunk_end_ is inside a quoted field, zero otherwise
+  uint64_t inside_quotes_;
+
+  // Removes the enclosing quotes of a quoted field. Escaped ("") quotes are
+  // collapsed in place, which is only attempted if the field contains a quote
+  // after the opening one.
+  static ArrowStringView Unquote(char* data, int64_t size) {
+    ArrowStringView view;
+    if (size == 0 || data[0] != '"') {
+      view.data = data;
+      view.size_bytes = size;
+      return view;
+    }
+
+    data++;
+    size--;
+    if (size > 0 && data[size - 1] == '"') {
+      size--;
+    }
+
+    char* quote = static_cast<char*>(memchr(data, '"', size));
+    if (quote != nullptr) {
+      char* out = quote;
+      for (char* in = quote; in < data + size; in++) {
+        *out++ = *in;
+        if (*in == '"' && in + 1 < data + size && in[1] == '"') {
+          in++;
+        }
+      }
+      size = out - data;
+    }
+
+    view.data = data;
+    view.size_bytes = size;
+    return view;
+  }
+
+  // Starts classifying chunks at pos_, outside of any quoted field
+  void ResetChunk() {
+    chunk_start_ = chunk_end_ = pos_;
+    structurals_ = 0;
+    newlines_ = 0;
+    inside_quotes_ = 0;
+  }
+
+  void ClassifyNextChunk() {
+    int64_t n = window_.size - chunk_end_;
+    SimpleCsvStructuralMasks masks;
+    if (n >= 64) {
+      SimpleCsvClassify(window_.data + chunk_end_, &masks);
+      n = 64;
+    } else {
+      // Pad the tail of the input so that the classifier can always read 64
+      // bytes. The zero padding never matches a structural character.
+      char tail[64];
+      memcpy(tail, window_.data + chunk_end_, n);
+      memset(tail + n, 0, 64 - n);
+      SimpleCsvClassify(tail, &masks);
+    }
+
+    uint64_t quoted = SimpleCsvPrefixXor(masks.quote) ^ inside_quotes_;
+    inside_quotes_ = 0 - (quoted >> 63);
+
+    chunk_start_ = chunk_end_;
+    chunk_end_ += n;
+    structurals_ = (masks.delimiter | masks.newline) & ~quoted;
+    newlines_ = masks.newline & ~quoted;
+  }
+
+  // Asks the input for the bytes after the current window, retaining the
+  // unfinished line (or the marked lines) at the front of the new window.
+  int Refill(int64_t* bytes_read, ArrowError* error) {
+    *bytes_read = 0;
+    if (eof_) {
+      return NANOARROW_OK;
+    }
+
+    int64_t retain_from = mark_ >= 0 ? mark_ : line_start_;
+    NANOARROW_RETURN_NOT_OK(input_->Next(&window_, retain_from, bytes_read, error));
+    window_offset_ += retain_from;
+    pos_ -= retain_from;
+    chunk_start_ -= retain_from;
+    chunk_end_ -= retain_from;
+    line_start_ -= retain_from;
+    if (mark_ >= 0) {
+      mark_ = 0;
+    }
+    eof_ = *bytes_read == 0;
+    return NANOARROW_OK;
+  }
+};
+
+// The private data of the ArrowArrayStream returned by
+// InitSimpleCsvArrayStream()
+class SimpleCsvArrayReader {
+ public:
+  virtual ~SimpleCsvArrayReader() {}
+  virtual int GetSchema(ArrowSchema* out) = 0;
+  virtual int GetArray(ArrowArray* out) = 0;
+  virtual const char* GetLastError() = 0;
+};
+
+// Narrows down the type of a column from a sample of its values: the column
+// gets the most specific type that every non-empty value can be converted to.
+// If max_distinct is positive, a string column with at most that many distinct
+// values is a DICTIONARY column.
+class SimpleCsvTypeGuess {
+ public:
+  explicit SimpleCsvTypeGuess(int64_t max_distinct = 0)
+      : candidates_(kAll), n_values_(0), max_distinct_(max_distinct) {}
+
+  // value.data is nullptr for a null
+  void Observe(ArrowStringView value) {
+    if (value.data == nullptr) {
+      return;
+    }
+
+    // Stop collecting values as soon as there are too many
+    if (static_cast<int64_t>(distinct_.size()) < max_distinct_ + 1) {
+      distinct_.emplace(value.data, value.size_bytes);
+    }
+
+    n_values_++;
+    bool bool_value;
+    int64_t int_value;
+    double double_value;
+    int32_t date_value;
+    if ((candidates_ & kBool) && !SimpleCsvParseBool(value, &bool_value)) {
+      candidates_ &= ~kBool;
+    }
+    if ((candidates_ & kInt64) && !SimpleCsvParseInt64(value, &int_value)) {
+      candidates_ &= ~kInt64;
+    }
+    if ((candidates_ & kDouble) && !SimpleCsvParseDouble(value, &double_value)) {
+      candidates_ &= ~kDouble;
+    }
+    if ((candidates_ & kDate32) && !SimpleCsvParseDate32(value, &date_value)) {
+      candidates_ &= ~kDate32;
+    }
+    if ((candidates_ & kTimestamp) && !SimpleCsvParseTimestamp(value, &int_value)) {
+      candidates_ &= ~kTimestamp;
+    }
+  }
+
+  SimpleCsvColumnType type() const {
+    if (n_values_ == 0) {
+      return SimpleCsvColumnType::STRING;
+    } else if (candidates_ & kBool) {
+      return SimpleCsvColumnType::BOOL;
+    } else if (candidates_ & kInt64) {
+      return SimpleCsvColumnType::INT64;
+    } else if (candidates_ & kDouble) {
+      return SimpleCsvColumnType::DOUBLE;
+    } else if (candidates_ & kDate32) {
+      return SimpleCsvColumnType::DATE32;
+    } else if (candidates_ & kTimestamp) {
+      return SimpleCsvColumnType::TIMESTAMP;
+    } else if (static_cast<int64_t>(distinct_.size()) <= max_distinct_) {
+      return SimpleCsvColumnType::DICTIONARY;
+    } else {
+      return SimpleCsvColumnType::STRING;
+    }
+  }
+
+ private:
+  enum { kBool = 1, kInt64 = 2, kDouble = 4, kDate32 = 8, kTimestamp = 16, kAll = 31 };
+
+  int candidates_;
+  int64_t n_values_;
+  int64_t max_distinct_;
+  std::unordered_set<std::string> distinct_;
+};
+
+// Assigns int32 indices to the distinct values of a DICTIONARY column in a
+// batch, appending each new value to the batch's dictionary. Values are looked
+// up in an open-addressing table of indices whose keys are compared with the
+// strings already in the dictionary, so each distinct value is copied once.
+class SimpleCsvDictionaryEncoder {
+ public:
+  SimpleCsvDictionaryEncoder() : dictionary_(nullptr), mask_(0) {}
+
+  // Starts encoding into the (empty) dictionary of a new batch
+  void Reset(ArrowArray* dictionary) {
+    dictionary_ = dictionary;
+    slots_.assign(kInitialSlots, -1);
+    mask_ = kInitialSlots - 1;
+    hashes_.clear();
+  }
+
+  // Sets *index to the index of value in the dictionary, adding value to the
+  // dictionary if it isn't already there. *added_bytes is the size of anything
+  // added.
+  int Encode(ArrowStringView value, int32_t* index, int64_t* added_bytes) {
+    uint64_t hash = Hash(value);
+    uint64_t slot = hash & mask_;
+    while (slots_[slot] >= 0) {
+      int32_t i = slots_[slot];
+      if (hashes_[i] == hash && Equals(i, value)) {
+        *index = i;
+        *added_bytes = 0;
+        return NANOARROW_OK;
+      }
+      slot = (slot + 1) & mask_;
+    }
+
+    *index = static_cast<int32_t>(hashes_.size());
+    NANOARROW_RETURN_NOT_OK(ArrowArrayAppendString(dictionary_, value));
+    slots_[slot] = *index;
+    hashes_.push_back(hash);
+    *added_bytes = value.size_bytes + sizeof(int32_t);
+
+    // Keep the table at most half full
+    if (hashes_.size() * 2 > slots_.size()) {
+      Grow();
+    }
+
+    return NANOARROW_OK;
+  }
+
+ private:
+  static constexpr int64_t kInitialSlots = 256;
+
+  ArrowArray* dictionary_;
+  std::vector<int32_t> slots_;
+  uint64_t mask_;
+  // The hash of each value in the dictionary
+  std::vector<uint64_t> hashes_;
+
+  // Mixes the value in a word at a time
+  static uint64_t Hash(ArrowStringView value) {
+    const char* data = value.data;
+    int64_t size = value.size_bytes;
+    uint64_t hash = 0x9E3779B97F4A7C15 ^ static_cast<uint64_t>(size);
+    uint64_t word;
+    for (; size >= 8; data += 8, size -= 8) {
+      memcpy(&word, data, sizeof(word));
+      hash = (hash ^ word) * 0xBF58476D1CE4E5B9;
+      hash ^= hash >> 29;
+    }
+
+    if (size > 0) {
+      word = 0;
+      memcpy(&word, data, size);
+      hash = (hash ^ word) * 0xBF58476D1CE4E5B9;
+    }
+
+    return hash ^ (hash >> 32);
+  }
+
+  bool Equals(int32_t i, ArrowStringView value) {
+    auto offsets =
+        reinterpret_cast<const int32_t*>(ArrowArrayBuffer(dictionary_, 1)->data);
+    int64_t size = offsets[i + 1] - offsets[i];
+    return size == value.size_bytes &&
+           (size == 0 || memcmp(ArrowArrayBuffer(dictionary_, 2)->data + offsets[i],
+                                value.data, size) == 0);
+  }
+
+  void Grow() {
+    slots_.assign(slots_.size() * 2, -1);
+    mask_ = slots_.size() - 1;
+    for (size_t i = 0; i < hashes_.size(); i++) {
+      uint64_t slot = hashes_[i] & mask_;
+      while (slots_[slot] >= 0) {
+        slot = (slot + 1) & mask_;
+      }
+      slots_[slot] = static_cast<int32_t>(i);
+    }
+  }
+};
+
+static const char* kSimpleCsvColumnTypeNames[] = {
+    "string", "int64", "double", "bool", "date32", "timestamp", "dictionary"};
+
+const char* SimpleCsvColumnTypeName(SimpleCsvColumnType type) {
+  return kSimpleCsvColumnTypeNames[static_cast<int>(type)];
+}
+
+bool SimpleCsvColumnTypeFromName(const std::string& name, SimpleCsvColumnType* out) {
+  for (int i = 0; i < 7; i++) {
+    if (name == kSimpleCsvColumnTypeNames[i]) {
+      *out = static_cast<SimpleCsvColumnType>(i);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// The size of each value of a column's data buffer, or 0 for columns that
+// aren't fixed-width bytes (strings and bit-packed bools)
+static int64_t SimpleCsvFixedWidth(SimpleCsvColumnType type) {
+  switch (type) {
+    case SimpleCsvColumnType::INT64:
+    case SimpleCsvColumnType::DOUBLE:
+    case SimpleCsvColumnType::TIMESTAMP:
+      return sizeof(int64_t);
+    case SimpleCsvColumnType::DATE32:
+    case SimpleCsvColumnType::DICTIONARY:
+      return sizeof(int32_t);
+    default:
+      return 0;
+  }
+}
+
+static int SimpleCsvSetColumnType(ArrowSchema* schema, SimpleCsvColumnType type,
+                                  bool large_string) {
+  switch (type) {
+    case SimpleCsvColumnType::INT64:
+      return ArrowSchemaSetType(schema, NANOARROW_TYPE_INT64);
+    case SimpleCsvColumnType::DOUBLE:
+      return ArrowSchemaSetType(schema, NANOARROW_TYPE_DOUBLE);
+    case SimpleCsvColumnType::BOOL:
+      return ArrowSchemaSetType(schema, NANOARROW_TYPE_BOOL);
+    case SimpleCsvColumnType::DATE32:
+      return ArrowSchemaSetType(schema, NANOARROW_TYPE_DATE32);
+    case SimpleCsvColumnType::TIMESTAMP:
+      return ArrowSchemaSetTypeDateTime(schema, NANOARROW_TYPE_TIMESTAMP,
+                                        NANOARROW_TIME_UNIT_MICRO, nullptr);
+    case SimpleCsvColumnType::DICTIONARY:
+      NANOARROW_RETURN_NOT_OK(ArrowSchemaSetType(schema, NANOARROW_TYPE_INT32));
+      NANOARROW_RETURN_NOT_OK(ArrowSchemaAllocateDictionary(schema));
+      ArrowSchemaInit(schema->dictionary);
+      return ArrowSchemaSetType(schema->dictionary, NANOARROW_TYPE_STRING);
+    default:
+      return ArrowSchemaSetType(
+          schema, large_string ? NANOARROW_TYPE_LARGE_STRING : NANOARROW_TYPE_STRING);
+  }
+}
+
+static int SimpleCsvGetColumnType(ArrowSchema* schema, SimpleCsvColumnType* out,
+                                  ArrowError* error) {
+  ArrowSchemaView schema_view;
+  NANOARROW_RETURN_NOT_OK(ArrowSchemaViewInit(&schema_view, schema, error));
+  switch (schema_view.type) {
+    case NANOARROW_TYPE_STRING:
+    case NANOARROW_TYPE_LARGE_STRING:
+      *out = SimpleCsvColumnType::STRING;
+      return NANOARROW_OK;
+    case NANOARROW_TYPE_INT64:
+      *out = SimpleCsvColumnType::INT64;
+      return NANOARROW_OK;
+    case NANOARROW_TYPE_DOUBLE:
+      *out = SimpleCsvColumnType::DOUBLE;
+      return NANOARROW_OK;
+    case NANOARROW_TYPE_BOOL:
+      *out = SimpleCsvColumnType::BOOL;
+      return NANOARROW_OK;
+    case NANOARROW_TYPE_DATE32:
+      *out = SimpleCsvColumnType::DATE32;
+      return NANOARROW_OK;
+    case NANOARROW_TYPE_TIMESTAMP:
+      *out = SimpleCsvColumnType::TIMESTAMP;
+      return NANOARROW_OK;
+    case NANOARROW_TYPE_DICTIONARY:
+      *out = SimpleCsvColumnType::DICTIONARY;
+      return NANOARROW_OK;
+    default:
+      ArrowErrorSet(error, "Unsupported column type");
+      return ENOTSUP;
+  }
+}
+
+// Opens an input that reads blocks of filename ahead of the parser with pread()
+static std::unique_ptr<SimpleCsvInput> SimpleCsvMakeReadaheadInput(
+    const std::string& filename, int64_t offset, const SimpleCsvOptions& options,
+    int64_t block_size) {
+  std::unique_ptr<SimpleCsvBlockSource> source(new SimpleCsvPreadSource(
+      filename, offset, options.readahead_blocks * block_size));
+  return std::unique_ptr<SimpleCsvInput>(new SimpleCsvReadaheadInput(
+      std::move(source), options.readahead_blocks, block_size));
+}
+
+// Opens the input for a scan of filename that starts at offset
+static std::unique_ptr<SimpleCsvInput> SimpleCsvMakeInput(const std::string& filename,
+                                                         int64_t offset,
+                                                         const SimpleCsvOptions& options,
+                                                         SimpleCsvSharedState* shared) {
+  int64_t block_size = SimpleCsvBufferedInput::kDefaultBlockSize;
+
+  // Compressed files are decompressed on the readahead thread whatever the
+  // input mode, since none of the others can read them
+  if (options.compression != SimpleCsvCompression::NONE) {
+    std::unique_ptr<SimpleCsvBlockSource> source(
+        new SimpleCsvDecompressSource(filename, options.compression, offset));
+    return std::unique_ptr<SimpleCsvInput>(new SimpleCsvReadaheadInput(
+        std::move(source), options.readahead_blocks, block_size));
+  }
+
+  switch (options.input_mode) {
+    case SimpleCsvInputMode::MMAP:
+      return std::unique_ptr<SimpleCsvInput>(new SimpleCsvMmapInput(filename, offset));
+    case SimpleCsvInputMode::IO_URING: {
+      std::shared_ptr<SimpleCsvUring> uring =
+          shared != nullptr ? shared->GetUring() : SimpleCsvUring::Make();
+      if (uring != nullptr) {
+        return std::unique_ptr<SimpleCsvInput>(new SimpleCsvUringInput(
+            std::move(uring), filename, offset, options.readahead_blocks, block_size));
+      }
+
+      // Without io_uring, read ahead with pread()
+      return SimpleCsvMakeReadaheadInput(filename, offset, options, block_size);
+    }
+    case SimpleCsvInputMode::READAHEAD:
+      return SimpleCsvMakeReadaheadInput(filename, offset, options, block_size);
+    default:
+      return std::unique_ptr<SimpleCsvInput>(
+          new SimpleCsvBufferedInput(filename, offset));
+  }
+}
+
+// Parses lines from a SimpleCsvScanner into batches, either reading the schema
+// from the header at the start of the file or parsing the records that start
+// in a byte range of the file using a known schema.
+class SimpleCsvArrayBuilder : public SimpleCsvArrayReader {
+ public:
+  SimpleCsvArrayBuilder(const std::string& filename, const SimpleCsvOptions& options,
+                        SimpleCsvSharedState* shared)
+      : SimpleCsvArrayBuilder(filename, options, shared, 0,
+                              std::numeric_limits<int64_t>::max()) {}
+
+  // Reads lines starting at begin until the next line would start at or after
+  // end. schema must have been read from the same file's header.
+  SimpleCsvArrayBuilder(const std::string& filename, const SimpleCsvOptions& options,
+                        SimpleCsvSharedState* shared, ArrowSchema* schema, int64_t begin,
+                        int64_t end)
+      : SimpleCsvArrayBuilder(filename, options, shared, begin, end) {
+    if (ArrowSchemaDeepCopy(schema, schema_.get()) != NANOARROW_OK) {
+      schema_.reset();
+    }
+  }
+
+  int GetSchema(ArrowSchema* out) override {
+    NANOARROW_RETURN_NOT_OK(ReadSchemaIfNeeded());
+    NANOARROW_RETURN_NOT_OK(ArrowSchemaDeepCopy(output_schema_.get(), out));
+    return NANOARROW_OK;
+  }
+
+  // The schema of all the columns in the file, of which GetSchema() only
+  // includes the projected ones
+  int GetFileSchema(ArrowSchema* out) {
+    NANOARROW_RETURN_NOT_OK(ReadSchemaIfNeeded());
+    NANOARROW_RETURN_NOT_OK(ArrowSchemaDeepCopy(schema_.get(), out));
+    return NANOARROW_OK;
+  }
+
+  int GetArray(ArrowArray* out) override {
+    if (status_ == ScanResult::DONE && !offsets_full_) {
+      out->release = nullptr;
+      return NANOARROW_OK;
+    }
+
+    NANOARROW_RETURN_NOT_OK(ReadSchemaIfNeeded());
+    NANOARROW_RETURN_NOT_OK(InitArrayIfNeeded());
+    NANOARROW_RETURN_NOT_OK(SkipOffsetIfNeeded());
+    if (indexing_ && index_.data_start < 0) {
+      index_.data_start = scanner_.position();
+    }
+
+    batch_bytes_ = 0;
+
+    // Start with the row that didn't fit in the previous batch
+    if (offsets_full_) {
+      offsets_full_ = false;
+      if (has_filter_) {
+        NANOARROW_RETURN_NOT_OK(AppendGroup());
+      } else {
+        NANOARROW_RETURN_NOT_OK(AppendRow(fields_.data()));
+      }
+    }
+
+    while (status_ != ScanResult::DONE) {
+      if (LimitReached()) {
+        status_ = ScanResult::DONE;
+        break;
+      }
+
+      if (BatchIsFull()) {
+        break;
+      }
+
+      if (has_filter_) {
+        NANOARROW_RETURN_NOT_OK(ReadFilteredLines());
+      } else {
+        NANOARROW_RETURN_NOT_OK(ReadLine());
+      }
+    }
+
+    // The rows have been copied out of the input, so release it (and its file)
+    // now rather than when the stream is released
+    if (status_ == ScanResult::DONE && !offsets_full_) {
+      scanner_.Close();
+    }
+
+    // Don't emit a trailing empty batch unless it is the only one
+    if (array_->length == 0 && status_ == ScanResult::DONE && batches_emitted_ > 0) {
+      array_.reset();
+      out->release = nullptr;
+      return NANOARROW_OK;
+    }
+
+    NANOARROW_RETURN_NOT_OK(FinishValidity());
+    NANOARROW_RETURN_NOT_OK(ArrowArrayFinishBuildingDefault(array_.get(), &last_error_));
+    rows_emitted_ += array_->length;
+    ArrowArrayMove(array_.get(), out);
+    batches_emitted_++;
+    return NANOARROW_OK;
+  }
+
+  const char* GetLastError() override { return last_error_.message; }
+
+  // Caches the schema in the database's shared state once it has been read
+  // from the header (see SimpleCsvMakeBuilder())
+  void CacheSchema(const std::string& key, const std::string& identity) {
+    cache_key_ = key;
+    file_identity_ = identity;
+  }
+
+  // Builds the index of the file from the records read, and writes it to path
+  // once the end of the file is reached. Only for a builder that reads the
+  // whole file without an offset.
+  void IndexRecords(const std::string& path, const std::string& identity,
+                    int64_t interval) {
+    indexing_ = true;
+    index_path_ = path;
+    index_.identity = identity;
+    index_.interval = interval;
+    index_.data_start = -1;
+  }
+
+  // Starts at position, the start of the record after the first rows records,
+  // rather than skipping those rows of the offset, once the header turns out to
+  // end at data_start. Used to start at an indexed record (see
+  // SimpleCsvMakeIndexedBuilder()).
+  void StartAt(int64_t data_start, int64_t position, int64_t rows) {
+    start_data_start_ = data_start;
+    start_position_ = position;
+    start_rows_ = rows;
+  }
+
+  int SkipPartialLine() { return scanner_.SkipPartialLine(&last_error_); }
+
+  // The position in the file of the next line that would be read
+  int64_t position() const { return scanner_.position(); }
+
+  // True if the end of the input has been reached
+  bool finished() const { return status_ == ScanResult::DONE && !offsets_full_; }
+
+ private:
+  // The most rows that fixed-width buffers are sized for when a batch starts
+  static constexpr int64_t kReserveRows = 65536;
+  // The most rows and (roughly) input bytes in a group of rows that is filtered
+  // at once. The bytes of the whole group stay in the scanner's window, so they
+  // are limited to about what fits in front of a block without copying it.
+  static constexpr int64_t kFilterGroupRows = 1024;
+  static constexpr int64_t kFilterGroupBytes = SimpleCsvBlockInput::kHeadroom;
+  // The most bytes of values a column with int32 offsets can hold
+  static constexpr int64_t kMaxOffset = std::numeric_limits<int32_t>::max();
+
+  std::string filename_;
+  SimpleCsvOptions options_;
+  SimpleCsvSharedState* shared_;
+  // Where to cache the schema read from the header, if anywhere
+  std::string cache_key_;
+  std::string file_identity_;
+  ScanResult status_;
+  SimpleCsvScanner scanner_;
+  SimpleCsvNullTokens null_tokens_;
+  int64_t end_;
+  std::vector<ArrowStringView> fields_;
+  // The index in the file of each output column and, for each field in the
+  // file, whether it is one of them
+  std::vector<int64_t> projection_;
+  std::vector<char> wanted_;
+  // The filter, if any, and the values of its columns for the current group of
+  // rows. The fields of the group's rows that are needed (the wanted_ ones, in
+  // file order) are kept as (offset, size) pairs relative to the scanner's mark,
+  // with an offset of -1 for a null.
+  bool has_filter_;
+  SimpleCsvFilter filter_;
+  std::vector<SimpleCsvFilterColumn> filter_values_;
+  std::vector<int64_t> wanted_slots_;
+  int64_t n_wanted_;
+  std::vector<int64_t> group_fields_;
+  std::vector<uint8_t> selected_;
+  std::vector<int64_t> selection_;
+  // The number of rows in selection_ and the next one to append
+  int64_t n_selected_;
+  int64_t next_selected_;
+  std::vector<ArrowStringView> row_;
+  // With a filter, the offset counts rows that pass it
+  int64_t rows_to_skip_;
+  std::vector<SimpleCsvColumnType> column_types_;
+  std::vector<SimpleCsvDictionaryEncoder> encoders_;
+  // The output columns whose values (or whose dictionary's values) have int32
+  // offsets, and whether the last row read didn't fit in them. That row is
+  // still in fields_ (or the current group) and starts the next batch.
+  std::vector<int64_t> offset32_columns_;
+  bool offsets_full_;
+  // For each column, the rows of the current batch that are null (one bit per
+  // row) and how many there are. The words are only allocated once a column
+  // has a null.
+  std::vector<std::vector<uint64_t>> null_words_;
+  std::vector<int64_t> null_counts_;
+  ArrowError last_error_;
+  // All the columns in the file and the projected columns in the output
+  nanoarrow::UniqueSchema schema_;
+  nanoarrow::UniqueSchema output_schema_;
+  nanoarrow::UniqueArray array_;
+  int64_t batches_emitted_;
+  int64_t rows_emitted_;
+  bool offset_skipped_;
+  // Approximate number of bytes appended to the current batch's buffers
+  int64_t batch_bytes_;
+  // The index being built from the records read (see IndexRecords())
+  bool indexing_;
+  SimpleCsvIndex index_;
+  std::string index_path_;
+  // Where to start instead of skipping the first rows of the offset (see
+  // StartAt())
+  int64_t start_data_start_;
+  int64_t start_position_;
+  int64_t start_rows_;
+
+  SimpleCsvArrayBuilder(const std::string& filename, const SimpleCsvOptions& options,
+                        SimpleCsvSharedState* shared, int64_t begin, int64_t end)
+      : filename_(filename),
+        options_(options),
+        shared_(shared),
+        status_(ScanResult::UNINITIALIZED),
+        scanner_(SimpleCsvMakeInput(filename, begin, options, shared), begin),
+        null_tokens_(options.null_values),
+        end_(end),
+        has_filter_(!options.filter.empty()),
+        n_wanted_(0),
+        n_selected_(0),
+        next_selected_(0),
+        rows_to_skip_(0),
+        offsets_full_(false),
+        batches_emitted_(0),
+        rows_emitted_(0),
+        offset_skipped_(false),
+        batch_bytes_(0),
+        indexing_(false),
+        start_data_start_(-1),
+        start_position_(-1),
+        start_rows_(0) {
+    ArrowErrorSet(&last_error_, "Internal error");
+  }
+
+  bool BatchIsFull() {
+    return offsets_full_ ||
+           (options_.batch_size_rows > 0 && array_->length >= options_.batch_size_rows) ||
+           (options_.batch_size_bytes > 0 && batch_bytes_ >= options_.batch_size_bytes);
+  }
+
+  bool LimitReached() {
+    return options_.limit >= 0 && rows_emitted_ + array_->length >= options_.limit;
+  }
+
+  // Skips the first offset rows without splitting them into fields
+  int SkipOffsetIfNeeded() {
+    if (offset_skipped_) {
+      return NANOARROW_OK;
+    }
+
+    offset_skipped_ = true;
+    if (options_.offset == 0 || LimitReached()) {
+      return NANOARROW_OK;
+    }
+
+    if (has_filter_) {
+      rows_to_skip_ = options_.offset;
+      return NANOARROW_OK;
+    }
+
+    int64_t to_skip = options_.offset;
+    if (start_rows_ > 0 && start_rows_ <= to_skip &&
+        scanner_.position() == start_data_start_) {
+      scanner_ = SimpleCsvScanner(
+          SimpleCsvMakeInput(filename_, start_position_, options_, shared_),
+          start_position_);
+      to_skip -= start_rows_;
+    }
+
+    int64_t skipped;
+    return scanner_.SkipLines(to_skip, &skipped, &status_, &last_error_);
+  }
+
+  int ReadSchemaIfNeeded() {
+    if (output_schema_->release != nullptr) {
+      return NANOARROW_OK;
+    }
+
+    if (schema_->release == nullptr) {
+      NANOARROW_RETURN_NOT_OK(ReadHeader());
+      if (shared_ != nullptr && !cache_key_.empty()) {
+        shared_->PutSchema(cache_key_, file_identity_, schema_.get(),
+                           scanner_.position());
+      }
+    } else {
+      std::vector<std::string> names;
+      for (int64_t i = 0; i < schema_->n_children; i++) {
+        names.emplace_back(schema_->children[i]->name);
+      }
+      NANOARROW_RETURN_NOT_OK(ProjectColumns(names));
+    }
+
+    ArrowSchemaInit(output_schema_.get());
+    NANOARROW_RETURN_NOT_OK(
+        ArrowSchemaSetTypeStruct(output_schema_.get(), projection_.size()));
+    for (size_t j = 0; j < projection_.size(); j++) {
+      ArrowSchema* child = output_schema_->children[j];
+      child->release(child);
+      NANOARROW_RETURN_NOT_OK(
+          ArrowSchemaDeepCopy(schema_->children[projection_[j]], child));
+    }
+
+    if (has_filter_) {
+      std::vector<SimpleCsvColumnType> types(schema_->n_children);
+      for (int64_t i = 0; i < schema_->n_children; i++) {
+        NANOARROW_RETURN_NOT_OK(
+            SimpleCsvGetColumnType(schema_->children[i], &types[i], &last_error_));
+      }
+      NANOARROW_RETURN_NOT_OK(filter_.Bind(types, &last_error_));
+
+      filter_values_.resize(filter_.columns().size());
+      for (size_t k = 0; k < filter_values_.size(); k++) {
+        filter_values_[k].type = types[filter_.columns()[k]];
+      }
+    }
+
+    return NANOARROW_OK;
+  }
+
+  // Chooses the output columns from the names of the columns in the file
+  int ProjectColumns(const std::vector<std::string>& names) {
+    projection_.clear();
+    if (options_.columns.empty()) {
+      for (size_t i = 0; i < names.size(); i++) {
+        projection_.push_back(i);
+      }
+    }
+
+    for (const std::string& column : options_.columns) {
+      auto name = std::find(names.begin(), names.end(), column);
+      if (name == names.end()) {
+        ArrowErrorSet(&last_error_, "Column '%s' not found in '%s'", column.c_str(),
+                      filename_.c_str());
+        return EINVAL;
+      }
+      projection_.push_back(name - names.begin());
+    }
+
+    wanted_.assign(names.size(), 0);
+    for (int64_t i : projection_) {
+      wanted_[i] = 1;
+    }
+
+    if (has_filter_) {
+      NANOARROW_RETURN_NOT_OK(filter_.Parse(options_.filter, names, &last_error_));
+      for (int64_t i : filter_.columns()) {
+        wanted_[i] = 1;
+      }
+
+      wanted_slots_.assign(names.size(), -1);
+      n_wanted_ = 0;
+      for (size_t i = 0; i < names.size(); i++) {
+        if (wanted_[i]) {
+          wanted_slots_[i] = n_wanted_++;
+        }
+      }
+      row_.resize(names.size());
+    }
+
+    return NANOARROW_OK;
+  }
+
+  // Reads the column names from the first line and decides their types
+  int ReadHeader() {
+    fields_.clear();
+    NANOARROW_RETURN_NOT_OK(scanner_.ReadLine(&fields_, &status_, &last_error_));
+
+    std::vector<std::string> names;
+    for (const ArrowStringView& field : fields_) {
+      names.emplace_back(field.data, field.size_bytes);
+    }
+    NANOARROW_RETURN_NOT_OK(ProjectColumns(names));
+
+    bool large_string;
+    NANOARROW_RETURN_NOT_OK(UseLargeString(&large_string));
+
+    std::vector<SimpleCsvColumnType> types(names.size(), SimpleCsvColumnType::STRING);
+    if (options_.infer_types && options_.infer_rows > 0 &&
+        status_ != ScanResult::DONE) {
+      NANOARROW_RETURN_NOT_OK(InferTypes(&types));
+    }
+
+    for (const auto& column_type : options_.column_types) {
+      auto name = std::find(names.begin(), names.end(), column_type.first);
+      if (name == names.end()) {
+        ArrowErrorSet(&last_error_, "Column '%s' given a type but not found in '%s'",
+                      column_type.first.c_str(), filename_.c_str());
+        return EINVAL;
+      }
+      types[name - names.begin()] = column_type.second;
+    }
+
+    ArrowSchemaInit(schema_.get());
+    NANOARROW_RETURN_NOT_OK(ArrowSchemaSetTypeStruct(schema_.get(), names.size()));
+    for (int64_t i = 0; i < schema_->n_children; i++) {
+      NANOARROW_RETURN_NOT_OK(
+          SimpleCsvSetColumnType(schema_->children[i], types[i], large_string));
+      NANOARROW_RETURN_NOT_OK(
+          ArrowSchemaSetName(schema_->children[i], names[i].c_str()));
+    }
+
+    return NANOARROW_OK;
+  }
+
+  // Decides whether STRING columns are large_string. For AUTO they are if a
+  // batch may hold more bytes than int32 offsets can address and the file is
+  // big enough to fill them (the size of a compressed file's data is unknown).
+  int UseLargeString(bool* out) {
+    switch (options_.large_string) {
+      case SimpleCsvLargeString::ALWAYS:
+        *out = true;
+        return NANOARROW_OK;
+      case SimpleCsvLargeString::NEVER:
+        *out = false;
+        return NANOARROW_OK;
+      default:
+        break;
+    }
+
+    *out = false;
+    if (options_.batch_size_bytes > 0 && options_.batch_size_bytes < kMaxOffset) {
+      return NANOARROW_OK;
+    }
+
+    if (options_.compression != SimpleCsvCompression::NONE) {
+      *out = true;
+      return NANOARROW_OK;
+    }
+
+    int64_t file_size;
+    NANOARROW_RETURN_NOT_OK(SimpleCsvFileSize(filename_, &file_size, &last_error_));
+    *out = file_size > kMaxOffset;
+    return NANOARROW_OK;
+  }
+
+  // Guesses column types from the rows after the header using a separate
+  // scanner, so that the sampled rows are parsed again as usual afterwards
+  int InferTypes(std::vector<SimpleCsvColumnType>* types) {
+    SimpleCsvOptions sample_options = options_;
+    sample_options.input_mode = SimpleCsvInputMode::BUFFERED;
+    int64_t offset = scanner_.position();
+    SimpleCsvScanner sample(
+        SimpleCsvMakeInput(filename_, offset, sample_options, nullptr), offset);
+
+    std::vector<SimpleCsvTypeGuess> guesses(
+        types->size(),
+        SimpleCsvTypeGuess(options_.dictionary ? options_.dictionary_max_values : 0));
+    ScanResult status = ScanResult::UNINITIALIZED;
+    int64_t n_rows = 0;
+    while (status != ScanResult::DONE && n_rows < options_.infer_rows) {
+      fields_.clear();
+      NANOARROW_RETURN_NOT_OK(
+          sample.ReadLine(&fields_, &status, &last_error_, &null_tokens_, &wanted_));
+
+      // Blank lines and lines with the wrong number of fields (which are
+      // reported when they are read for real) are not evidence
+      if (fields_.size() != guesses.size() || sample.blank()) {
+        continue;
+      }
+
+      for (size_t i = 0; i < guesses.size(); i++) {
+        if (wanted_[i]) {
+          guesses[i].Observe(fields_[i]);
+        }
+      }
+      n_rows++;
+    }
+
+    for (size_t i = 0; i < guesses.size(); i++) {
+      (*types)[i] = guesses[i].type();
+    }
+
+    return NANOARROW_OK;
+  }
+
+  int InitArrayIfNeeded() {
+    if (array_->release != nullptr) {
+      return NANOARROW_OK;
+    }
+
+    if (column_types_.empty()) {
+      column_types_.resize(output_schema_->n_children);
+      for (int64_t i = 0; i < output_schema_->n_children; i++) {
+        NANOARROW_RETURN_NOT_OK(SimpleCsvGetColumnType(
+            output_schema_->children[i], &column_types_[i], &last_error_));
+
+        ArrowSchemaView schema_view;
+        NANOARROW_RETURN_NOT_OK(
+            ArrowSchemaViewInit(&schema_view, output_schema_->children[i], &last_error_));
+        if (schema_view.type == NANOARROW_TYPE_STRING ||
+            schema_view.type == NANOARROW_TYPE_DICTIONARY) {
+          offset32_columns_.push_back(i);
+        }
+      }
+    }
+
+    NANOARROW_RETURN_NOT_OK(
+        ArrowArrayInitFromSchema(array_.get(), output_schema_.get(), &last_error_));
+    NANOARROW_RETURN_NOT_OK(ArrowArrayStartAppending(array_.get()));
+
+    // Size fixed-width columns for a full batch up front so that
+    // AppendParsed() rarely has to grow them
+    int64_t expected_rows = std::min<int64_t>(options_.batch_size_rows, kReserveRows);
+    if (expected_rows <= 0) {
+      expected_rows = kReserveRows;
+    }
+    for (int64_t i = 0; i < output_schema_->n_children; i++) {
+      int64_t width = SimpleCsvFixedWidth(column_types_[i]);
+      if (width > 0) {
+        NANOARROW_RETURN_NOT_OK(ArrowBufferReserve(
+            ArrowArrayBuffer(array_->children[i], 1), expected_rows * width));
+      }
+    }
+
+    // Each batch has its own dictionaries
+    encoders_.resize(output_schema_->n_children);
+    for (int64_t i = 0; i < output_schema_->n_children; i++) {
+      if (column_types_[i] == SimpleCsvColumnType::DICTIONARY) {
+        encoders_[i].Reset(array_->children[i]->dictionary);
+      }
+    }
+
+    null_words_.resize(output_schema_->n_children);
+    null_counts_.assign(output_schema_->n_children, 0);
+    for (auto& words : null_words_) {
+      words.clear();
+    }
+
+    return NANOARROW_OK;
+  }
+
+  // Gives the columns that had nulls in this batch a validity bitmap, made a
+  // word at a time from the null bits
+  int FinishValidity() {
+    int64_t length = array_->length;
+    for (int64_t i = 0; i < output_schema_->n_children; i++) {
+      if (null_counts_[i] == 0) {
+        continue;
+      }
+
+      std::vector<uint64_t>& words = null_words_[i];
+      int64_t n_words = (length + 63) / 64;
+      words.resize(n_words, 0);
+
+      ArrowBitmap* validity = ArrowArrayValidityBitmap(array_->children[i]);
+      NANOARROW_RETURN_NOT_OK(ArrowBitmapReserve(validity, n_words * 64));
+      uint8_t* out = validity->buffer.data;
+      for (int64_t j = 0; j < n_words; j++) {
+        uint64_t valid = ~words[j];
+        for (int k = 0; k < 8; k++) {
+          out[j * 8 + k] = static_cast<uint8_t>(valid >> (8 * k));
+        }
+      }
+
+      validity->size_bits = length;
+      validity->buffer.size_bytes = (length + 7) / 8;
+      array_->children[i]->null_count = null_counts_[i];
+    }
+
+    return NANOARROW_OK;
+  }
+
+  // Reads the next line into fields_. *is_row is false for a blank line and
+  // at the end of the builder's range.
+  int ReadFields(bool* is_row) {
+    *is_row = false;
+    if (scanner_.position() >= end_) {
+      status_ = ScanResult::DONE;
+      return NANOARROW_OK;
+    }
+
+    int64_t line_start = scanner_.position();
+    fields_.clear();
+    NANOARROW_RETURN_NOT_OK(
+        scanner_.ReadLine(&fields_, &status_, &last_error_, &null_tokens_, &wanted_));
+    bool blank = scanner_.blank();
+    if (indexing_) {
+      IndexLine(line_start, blank);
+    }
+
+    // Skip blank line
+    if (blank) {
+      return NANOARROW_OK;
+    }
+
+    if (schema_->n_children != fields_.size()) {
+      ArrowErrorSet(&last_error_, "Expected %ld fields but found %ld fields",
+                    (long)schema_->n_children, (long)fields_.size());
+      return EINVAL;
+    }
+
+    *is_row = true;
+    return NANOARROW_OK;
+  }
+
+  // Adds the line just read to the index if it is a record, then writes the
+  // index at the end of the file
+  void IndexLine(int64_t line_start, bool blank) {
+    if (!blank) {
+      index_.Add(line_start);
+    }
+
+    // An index is only an optimization, so failing to write one is not an error
+    if (status_ == ScanResult::DONE) {
+      indexing_ = false;
+      ArrowError error;
+      SimpleCsvWriteIndex(index_path_, index_, &error);
+    }
+  }
+
+  int ReadLine() {
+    bool is_row;
+    NANOARROW_RETURN_NOT_OK(ReadFields(&is_row));
+    if (!is_row) {
+      return NANOARROW_OK;
+    }
+
+    return AppendRow(fields_.data());
+  }
+
+  // Appends the projected fields of a line, given all of its fields. A line
+  // whose values would overflow a column's int32 offsets sets offsets_full_
+  // instead.
+  int AppendRow(const ArrowStringView* fields) {
+    if (!offset32_columns_.empty()) {
+      bool fits;
+      NANOARROW_RETURN_NOT_OK(CheckOffsets(fields, &fits));
+      if (!fits) {
+        offsets_full_ = true;
+        return NANOARROW_OK;
+      }
+    }
+
+    for (size_t j = 0; j < projection_.size(); j++) {
+      NANOARROW_RETURN_NOT_OK(AppendField(j, fields[projection_[j]]));
+    }
+
+    NANOARROW_RETURN_NOT_OK(ArrowArrayFinishElement(array_.get()));
+    return NANOARROW_OK;
+  }
+
+  // Checks that the values of a line fit in the int32 offsets of the columns
+  // that have them. A line that doesn't fit in an empty batch is an error.
+  int CheckOffsets(const ArrowStringView* fields, bool* fits) {
+    *fits = true;
+    for (int64_t i : offset32_columns_) {
+      ArrowArray* column = array_->children[i];
+      if (column->dictionary != nullptr) {
+        column = column->dictionary;
+      }
+
+      int64_t size = ArrowArrayBuffer(column, 2)->size_bytes;
+      if (size + fields[projection_[i]].size_bytes <= kMaxOffset) {
+        continue;
+      }
+
+      if (array_->length == 0) {
+        ArrowErrorSet(&last_error_,
+                      "Value in column '%s' is too large for a string column (see "
+                      "the large_string option)",
+                      output_schema_->children[i]->name);
+        return EOVERFLOW;
+      }
+
+      *fits = false;
+      return NANOARROW_OK;
+    }
+
+    return NANOARROW_OK;
+  }
+
+  // Reads a group of lines, keeping them all in the scanner's window, then
+  // evaluates the filter over the whole group and appends only the rows that
+  // pass. The others are never unquoted into an output buffer.
+  int ReadFilteredLines() {
+    int64_t max_rows = kFilterGroupRows;
+    if (options_.batch_size_rows > 0) {
+      max_rows = std::min(max_rows, options_.batch_size_rows - array_->length);
+    }
+
+    group_fields_.clear();
+    int64_t n_rows = 0;
+    scanner_.Mark();
+    while (n_rows < max_rows && status_ != ScanResult::DONE &&
+           scanner_.marked_size() < kFilterGroupBytes) {
+      bool is_row;
+      NANOARROW_RETURN_NOT_OK(ReadFields(&is_row));
+      if (!is_row) {
+        continue;
+      }
+
+      // Offsets from the mark stay valid when the window moves
+      const char* base = scanner_.marked_data();
+      for (size_t i = 0; i < fields_.size(); i++) {
+        if (wanted_[i]) {
+          const ArrowStringView& field = fields_[i];
+          group_fields_.push_back(field.data == nullptr ? -1 : field.data - base);
+          group_fields_.push_back(field.size_bytes);
+        }
+      }
+      n_rows++;
+    }
+
+    const char* base = scanner_.marked_data();
+    const std::vector<int64_t>& filter_columns = filter_.columns();
+    for (size_t k = 0; k < filter_columns.size(); k++) {
+      SimpleCsvFilterColumn& values = filter_values_[k];
+      values.Clear();
+      for (int64_t row = 0; row < n_rows; row++) {
+        ArrowStringView value = GroupField(base, row, filter_columns[k]);
+        if (!values.Append(value)) {
+          return ConversionError(schema_->children[filter_columns[k]]->name, values.type,
+                                 value);
+        }
+      }
+    }
+
+    selected_.resize(n_rows);
+    filter_.Evaluate(filter_values_, n_rows, selected_.data());
+
+    // Collect the indices of the rows that passed without branching on each
+    selection_.resize(n_rows);
+    n_selected_ = 0;
+    for (int64_t row = 0; row < n_rows; row++) {
+      selection_[n_selected_] = row;
+      n_selected_ += selected_[row];
+    }
+
+    next_selected_ = 0;
+    return AppendGroup();
+  }
+
+  // Appends the rows of the current group that passed the filter, starting
+  // from the first that hasn't been appended. The group is released once they
+  // all have been (or the limit is reached).
+  int AppendGroup() {
+    const char* base = scanner_.marked_data();
+    for (; next_selected_ < n_selected_; next_selected_++) {
+      if (rows_to_skip_ > 0) {
+        rows_to_skip_--;
+        continue;
+      }
+
+      if (LimitReached()) {
+        break;
+      }
+
+      for (int64_t i : projection_) {
+        row_[i] = GroupField(base, selection_[next_selected_], i);
+      }
+      NANOARROW_RETURN_NOT_OK(AppendRow(row_.data()));
+      if (offsets_full_) {
+        return NANOARROW_OK;
+      }
+    }
+
+    scanner_.Unmark();
+    return NANOARROW_OK;
+  }
+
+  // The field of file column i in a row of the current group
+  ArrowStringView GroupField(const char* base, int64_t row, int64_t i) {
+    const int64_t* field =
+        group_fields_.data() + (row * n_wanted_ + wanted_slots_[i]) * 2;
+    if (field[0] < 0) {
+      return {nullptr, 0};
+    }
+
+    return {base + field[0], field[1]};
+  }
+
+  // Appends a field to column i, converting it to the column's type. Null
+  // tokens were replaced by a nullptr data pointer while scanning.
+  int AppendField(int64_t i, ArrowStringView value) {
+    if (value.data == nullptr) {
+      return AppendNull(i);
+    }
+
+    ArrowArray* column = array_->children[i];
+    SimpleCsvColumnType type = column_types_[i];
+    if (type == SimpleCsvColumnType::STRING) {
+      batch_bytes_ += value.size_bytes + sizeof(int32_t);
+      return ArrowArrayAppendString(column, value);
+    }
+
+    bool ok;
+    switch (type) {
+      case SimpleCsvColumnType::INT64:
+        return AppendParsed<int64_t, SimpleCsvParseInt64>(i, value);
+      case SimpleCsvColumnType::DOUBLE:
+        return AppendParsed<double, SimpleCsvParseDouble>(i, value);
+      case SimpleCsvColumnType::BOOL: {
+        bool parsed;
+        ok = SimpleCsvParseBool(value, &parsed);
+        if (ok) {
+          NANOARROW_RETURN_NOT_OK(ArrowArrayAppendInt(column, parsed));
+        }
+        break;
+      }
+      case SimpleCsvColumnType::DATE32:
+        return AppendParsed<int32_t, SimpleCsvParseDate32>(i, value);
+      case SimpleCsvColumnType::TIMESTAMP:
+        return AppendParsed<int64_t, SimpleCsvParseTimestamp>(i, value);
+      case SimpleCsvColumnType::DICTIONARY:
+        return AppendEncoded(i, value);
+      default:
+        ok = false;
+        break;
+    }
+
+    if (!ok) {
+      return ConversionError(i, value);
+    }
+
+    batch_bytes_ += sizeof(int64_t);
+    return NANOARROW_OK;
+  }
+
+  // Parses value straight into the end of a fixed-width column's data buffer,
+  // skipping ArrowArrayAppendInt()'s dispatch on the storage type
+  template <typename T, bool (*Parse)(ArrowStringView, T*)>
+  int AppendParsed(int64_t i, ArrowStringView value) {
+    ArrowArray* column = array_->children[i];
+    ArrowBuffer* data = ArrowArrayBuffer(column, 1);
+    NANOARROW_RETURN_NOT_OK(ArrowBufferReserve(data, sizeof(T)));
+    auto out = reinterpret_cast<T*>(data->data + data->size_bytes);
+    if (!Parse(value, out)) {
+      return ConversionError(i, value);
+    }
+    data->size_bytes += sizeof(T);
+    column->length++;
+    batch_bytes_ += sizeof(T);
+    return NANOARROW_OK;
+  }
+
+  // Appends the index of value in column i's dictionary
+  int AppendEncoded(int64_t i, ArrowStringView value) {
+    ArrowArray* column = array_->children[i];
+    int32_t index;
+    int64_t added_bytes;
+    NANOARROW_RETURN_NOT_OK(encoders_[i].Encode(value, &index, &added_bytes));
+    NANOARROW_RETURN_NOT_OK(ArrowBufferAppendInt32(ArrowArrayBuffer(column, 1), index));
+    column->length++;
+    batch_bytes_ += sizeof(int32_t) + added_bytes;
+    return NANOARROW_OK;
+  }
+
+  // Records a null in column i and appends a placeholder value. The column's
+  // validity bitmap stays unallocated until FinishValidity(), so the
+  // nanoarrow append functions never touch it.
+  int AppendNull(int64_t i) {
+    int64_t row = array_->length;
+    std::vector<uint64_t>& words = null_words_[i];
+    if (static_cast<int64_t>(words.size()) <= row / 64) {
+      words.resize(row / 64 + 1, 0);
+    }
+    words[row / 64] |= uint64_t(1) << (row % 64);
+    null_counts_[i]++;
+
+    ArrowArray* column = array_->children[i];
+    int64_t width = SimpleCsvFixedWidth(column_types_[i]);
+    batch_bytes_ += width;
+    if (width > 0) {
+      NANOARROW_RETURN_NOT_OK(
+          ArrowBufferAppendFill(ArrowArrayBuffer(column, 1), 0, width));
+      column->length++;
+      return NANOARROW_OK;
+    } else if (column_types_[i] == SimpleCsvColumnType::BOOL) {
+      return ArrowArrayAppendInt(column, 0);
+    } else {
+      batch_bytes_ += sizeof(int32_t);
+      return ArrowArrayAppendString(column, ArrowCharView(""));
+    }
+  }
+
+  int ConversionError(int64_t i, ArrowStringView value) {
+    return ConversionError(output_schema_->children[i]->name, column_types_[i], value);
+  }
+
+  int ConversionError(const char* name, SimpleCsvColumnType type, ArrowStringView value) {
+    ArrowErrorSet(&last_error_, "Can't convert '%.*s' in column '%s' to %s",
+                  static_cast<int>(std::min<int64_t>(value.size_bytes, 100)), value.data,
+                  name, SimpleCsvColumnTypeName(type));
+    return EINVAL;
+  }
+};
+
+// The key of a file's schema in the cache of a SimpleCsvSharedState: its name
+// and the options that decide the schema read from its header
+static std::string SimpleCsvSchemaCacheKey(const std::string& filename,
+                                           const SimpleCsvOptions& options) {
+  std::string key;
+  auto add = [&key](const std::string& value) {
+    key += value;
+    key.push_back('\0');
+  };
+
+  add(filename);
+  add(std::to_string(options.infer_types));
+  add(std::to_string(options.infer_rows));
+  add(std::to_string(options.dictionary));
+  add(std::to_string(options.dictionary_max_values));
+  add(std::to_string(static_cast<int>(options.large_string)));
+  add(std::to_string(options.batch_size_bytes));
+  for (const auto& column_type : options.column_types) {
+    add(column_type.first + ":" + SimpleCsvColumnTypeName(column_type.second));
+  }
+  add("");
+  // Only the columns that are read are sampled to infer types
+  for (const std::string& column : options.columns) {
+    add(column);
+  }
+  add("");
+  for (const std::string& null_value : options.null_values) {
+    add(null_value);
+  }
+  add("");
+  add(options.filter);
+  return key;
+}
+
+// Makes a builder for a whole file. If the database has already read the
+// header of this version of the file with the same options, the builder uses
+// that schema and starts at the first record; otherwise it caches the schema
+// it reads.
+static std::unique_ptr<SimpleCsvArrayBuilder> SimpleCsvMakeBuilder(
+    const std::string& filename, const SimpleCsvOptions& options,
+    SimpleCsvSharedState* shared) {
+  std::string identity;
+  ArrowError error;
+  if (shared == nullptr ||
+      SimpleCsvFileIdentity(filename, &identity, &error) != NANOARROW_OK) {
+    return std::unique_ptr<SimpleCsvArrayBuilder>(
+        new SimpleCsvArrayBuilder(filename, options, shared));
+  }
+
+  std::string key = SimpleCsvSchemaCacheKey(filename, options);
+  nanoarrow::UniqueSchema schema;
+  int64_t data_start;
+  if (shared->GetSchema(key, identity, schema.get(), &data_start)) {
+    return std::unique_ptr<SimpleCsvArrayBuilder>(new SimpleCsvArrayBuilder(
+        filename, options, shared, schema.get(), data_start,
+        std::numeric_limits<int64_t>::max()));
+  }
+
+  std::unique_ptr<SimpleCsvArrayBuilder> builder(
+      new SimpleCsvArrayBuilder(filename, options, shared));
+  builder->CacheSchema(key, identity);
+  return builder;
+}
+
+// Reads the index of this version of the file, if options.index is set and
+// the file has one
+static bool SimpleCsvLoadIndex(const std::string& filename,
+                               const SimpleCsvOptions& options, SimpleCsvIndex* out) {
+  std::string identity;
+  ArrowError error;
+  return options.index &&
+         SimpleCsvFileIdentity(filename, &identity, &error) == NANOARROW_OK &&
+         SimpleCsvReadIndex(SimpleCsvIndexPath(filename, options.sidecar_dir), identity,
+                            out, &error) == NANOARROW_OK;
+}
+
+// Makes a builder for a whole file that uses or builds its index if
+// options.index is set. With an index, a read with an offset starts at the
+// indexed record before it rather than skipping every line up to it (unless
+// the offset counts rows that pass a filter). The positions in the index of a
+// compressed file are in its decompressed data, which can only be reached by
+// decompressing everything before them, so their index is only used to count
+// rows.
+static std::unique_ptr<SimpleCsvArrayBuilder> SimpleCsvMakeIndexedBuilder(
+    const std::string& filename, const SimpleCsvOptions& options,
+    SimpleCsvSharedState* shared) {
+  std::unique_ptr<SimpleCsvArrayBuilder> builder =
+      SimpleCsvMakeBuilder(filename, options, shared);
+  if (!options.index) {
+    return builder;
+  }
+
+  SimpleCsvIndex index;
+  if (!SimpleCsvLoadIndex(filename, options, &index)) {
+    std::string identity;
+    ArrowError error;
+    if (options.offset == 0 &&
+        SimpleCsvFileIdentity(filename, &identity, &error) == NANOARROW_OK) {
+      builder->IndexRecords(SimpleCsvIndexPath(filename, options.sidecar_dir), identity,
+                            options.index_interval);
+    }
+    return builder;
+  }
+
+  int64_t k = std::min<int64_t>(options.offset / index.interval,
+                                static_cast<int64_t>(index.offsets.size()) - 1);
+  if (k > 0 && options.filter.empty() &&
+      options.compression == SimpleCsvCompression::NONE) {
+    builder->StartAt(index.data_start, index.offsets[k], k * index.interval);
+  }
+  return builder;
+}
+
+// Parses a file using several threads. The file (after the header) is divided
+// into chunks of roughly equal size that worker threads parse into their own
+// batches, which are returned in file order.
+//
+// A worker cannot know whether the start of its chunk is inside a quoted field,
+// so it guesses (see SimpleCsvScanner::SkipPartialLine()): it begins at the
+// first line that starts in its chunk and continues until the first line that
+// ends at or after the start of the next chunk. The previous chunk's end is
+// exact if its own start was, so a chunk whose start does not match the end of
+// the previous one began inside a quoted field and is parsed again (rarely,
+// and on the consumer's thread) from the correct position. If the file has an
+// index, chunks start at indexed records instead, so that none of them has to
+// guess.
+class SimpleCsvParallelReader : public SimpleCsvArrayReader {
+ public:
+  SimpleCsvParallelReader(const std::string& filename, const SimpleCsvOptions& options,
+                          std::shared_ptr<SimpleCsvSharedState> shared)
+      : filename_(filename),
+        options_(options),
+        shared_(std::move(shared)),
+        initialized_(false),
+        code_(NANOARROW_OK),
+        data_start_(0),
+        chunk_size_(0),
+        next_chunk_(0),
+        current_chunk_(0),
+        cancelled_(false),
+        header_only_(false),
+        batches_emitted_(0) {
+    ArrowErrorSet(&last_error_, "Internal error");
+  }
+
+  ~SimpleCsvParallelReader() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cancelled_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  int GetSchema(ArrowSchema* out) override {
+    NANOARROW_RETURN_NOT_OK(InitIfNeeded());
+    NANOARROW_RETURN_NOT_OK(ArrowSchemaDeepCopy(schema_.get(), out));
+    return NANOARROW_OK;
+  }
+
+  int GetArray(ArrowArray* out) override {
+    NANOARROW_RETURN_NOT_OK(InitIfNeeded());
+
+    while (ready_.empty() && current_chunk_ < chunks_.size()) {
+      code_ = CollectNextChunk();
+      NANOARROW_RETURN_NOT_OK(code_);
+    }
+
+    if (!ready_.empty()) {
+      ready_.front().move(out);
+      ready_.pop_front();
+      batches_emitted_++;
+      return NANOARROW_OK;
+    }
+
+    // Like the single-threaded reader, return one empty batch for a file
+    // without any rows
+    if (batches_emitted_ == 0 && !header_only_) {
+      nanoarrow::UniqueArray array;
+      NANOARROW_RETURN_NOT_OK(
+          ArrowArrayInitFromSchema(array.get(), schema_.get(), &last_error_));
+      NANOARROW_RETURN_NOT_OK(ArrowArrayStartAppending(array.get()));
+      NANOARROW_RETURN_NOT_OK(ArrowArrayFinishBuildingDefault(array.get(), &last_error_));
+      array.move(out);
+      batches_emitted_++;
+      return NANOARROW_OK;
+    }
+
+    out->release = nullptr;
+    return NANOARROW_OK;
+  }
+
+  const char* GetLastError() override { return last_error_.message; }
+
+ private:
+  // Chunks are sized so that each thread gets a few of them
+  static constexpr int64_t kMinChunkSize = 4 * 1024 * 1024;
+  static constexpr int64_t kMaxChunkSize = 64 * 1024 * 1024;
+
+  struct Chunk {
+    Chunk() : done(false), code(NANOARROW_OK), begin(0), end(0) {}
+
+    bool done;
+    int code;
+    std::string error;
+    // The position of the first line parsed and of the line after the last
+    int64_t begin;
+    int64_t end;
+    std::vector<nanoarrow::UniqueArray> batches;
+  };
+
+  std::string filename_;
+  SimpleCsvOptions options_;
+  std::shared_ptr<SimpleCsvSharedState> shared_;
+  bool initialized_;
+  int code_;
+  ArrowError last_error_;
+  // The output schema and the schema of all the columns in the file, which
+  // workers need to find the projected columns
+  nanoarrow::UniqueSchema schema_;
+  nanoarrow::UniqueSchema file_schema_;
+  int64_t data_start_;
+  int64_t chunk_size_;
+  // The start of each chunk if they were chosen from an index, or empty if
+  // they are multiples of chunk_size_
+  std::vector<int64_t> chunk_begins_;
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Chunk> chunks_;
+  size_t next_chunk_;
+  size_t current_chunk_;
+  bool cancelled_;
+
+  // The position at which the next chunk must start
+  int64_t expected_begin_;
+  std::deque<nanoarrow::UniqueArray> ready_;
+  bool header_only_;
+  int64_t batches_emitted_;
+
+  int InitIfNeeded() {
+    if (initialized_) {
+      return code_;
+    }
 
-  std::pair<ScanResult, std::string> ReadField() {
-    std::stringstream stream;
+    initialized_ = true;
+    code_ = Init();
+    return code_;
+  }
+
+  int Init() {
+    // Read the header on this thread to get the schema and where the data starts
+    std::unique_ptr<SimpleCsvArrayBuilder> header =
+        SimpleCsvMakeBuilder(filename_, options_, shared_.get());
+    int code = header->GetSchema(schema_.get());
+    if (code == NANOARROW_OK) {
+      code = header->GetFileSchema(file_schema_.get());
+    }
+    if (code != NANOARROW_OK) {
+      ArrowErrorSet(&last_error_, "%s", header->GetLastError());
+      return code;
+    }
+
+    data_start_ = header->position();
+    expected_begin_ = data_start_;
+
+    // A file that ends in its header has no batches at all
+    if (header->finished()) {
+      header_only_ = true;
+      return NANOARROW_OK;
+    }
+
+    int64_t file_size;
+    NANOARROW_RETURN_NOT_OK(SimpleCsvFileSize(filename_, &file_size, &last_error_));
+    int64_t data_size = file_size - data_start_;
+    if (data_size <= 0) {
+      return NANOARROW_OK;
+    }
+
+    chunk_size_ = data_size / (options_.threads * 4) + 1;
+    chunk_size_ = std::max(kMinChunkSize, std::min(kMaxChunkSize, chunk_size_));
+    chunks_.resize((data_size + chunk_size_ - 1) / chunk_size_);
+
+    SimpleCsvIndex index;
+    if (SimpleCsvLoadIndex(filename_, options_, &index) &&
+        index.data_start == data_start_) {
+      chunk_begins_.push_back(data_start_);
+      for (int64_t offset : index.offsets) {
+        if (offset >= chunk_begins_.back() + chunk_size_ && offset < file_size) {
+          chunk_begins_.push_back(offset);
+        }
+      }
+      chunks_.resize(chunk_begins_.size());
+    }
+
+    int64_t n_workers = std::min<int64_t>(options_.threads, chunks_.size());
+    for (int64_t i = 0; i < n_workers; i++) {
+      workers_.push_back(std::thread(&SimpleCsvParallelReader::Work, this));
+    }
+
+    return NANOARROW_OK;
+  }
+
+  int64_t ChunkBegin(size_t i) {
+    if (chunk_begins_.empty()) {
+      return data_start_ + i * chunk_size_;
+    } else {
+      return chunk_begins_[i];
+    }
+  }
+
+  int64_t ChunkEnd(size_t i) {
+    if (i + 1 == chunks_.size()) {
+      return std::numeric_limits<int64_t>::max();
+    } else {
+      return ChunkBegin(i + 1);
+    }
+  }
+
+  void Work() {
+    // Don't get too far ahead of the consumer
+    size_t max_ahead = 2 * options_.threads;
 
     while (true) {
-      int item = input_.get();
-      switch (item) {
-        case ',':
-          return {ScanResult::FIELD_SEP, stream.str()};
-        case '\n':
-          return {ScanResult::LINE_SEP, stream.str()};
-        case EOF:
-          return {ScanResult::DONE, stream.str()};
-        default:
-          stream << static_cast<char>(item);
-          break;
+      size_t i;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&] {
+          return cancelled_ || next_chunk_ >= chunks_.size() ||
+                 next_chunk_ < current_chunk_ + max_ahead;
+        });
+        if (cancelled_ || next_chunk_ >= chunks_.size()) {
+          return;
+        }
+
+        i = next_chunk_++;
+      }
+
+      Chunk chunk;
+      ParseChunk(ChunkBegin(i), i > 0 && chunk_begins_.empty(), ChunkEnd(i), &chunk);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        chunks_[i] = std::move(chunk);
+        chunks_[i].done = true;
       }
+      cv_.notify_all();
     }
   }
 
-  ScanResult ReadLine(std::vector<std::string>* values) {
-    std::pair<ScanResult, std::string> result;
+  void ParseChunk(int64_t begin, bool find_line_start, int64_t end, Chunk* chunk) {
+    // When looking for the start of a line, include the byte before the
+    // chunk so that a chunk that starts with a line is not skipped
+    int64_t offset = find_line_start ? begin - 1 : begin;
+    SimpleCsvArrayBuilder builder(filename_, options_, shared_.get(), file_schema_.get(),
+                                  offset, end);
+    if (find_line_start) {
+      chunk->code = builder.SkipPartialLine();
+    }
+
+    chunk->begin = builder.position();
+
+    while (chunk->code == NANOARROW_OK) {
+      nanoarrow::UniqueArray batch;
+      chunk->code = builder.GetArray(batch.get());
+      if (chunk->code != NANOARROW_OK || batch->release == nullptr) {
+        break;
+      }
 
-    do {
-      result = ReadField();
-      values->push_back(result.second);
-    } while (result.first == ScanResult::FIELD_SEP);
+      if (batch->length > 0) {
+        chunk->batches.push_back(std::move(batch));
+      }
+    }
+
+    if (chunk->code != NANOARROW_OK) {
+      chunk->error = builder.GetLastError();
+    }
 
-    return result.first;
+    chunk->end = builder.position();
   }
 
- private:
-  std::ifstream input_;
+  int CollectNextChunk() {
+    Chunk chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [&] { return chunks_[current_chunk_].done; });
+      chunk = std::move(chunks_[current_chunk_]);
+    }
+
+    if (chunk.begin != expected_begin_) {
+      Chunk reparsed;
+      ParseChunk(expected_begin_, false, ChunkEnd(current_chunk_), &reparsed);
+      chunk = std::move(reparsed);
+    }
+
+    if (chunk.code != NANOARROW_OK) {
+      ArrowErrorSet(&last_error_, "%s", chunk.error.c_str());
+      return chunk.code;
+    }
+
+    for (auto& batch : chunk.batches) {
+      ready_.push_back(std::move(batch));
+    }
+
+    expected_begin_ = chunk.end;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      current_chunk_++;
+    }
+    cv_.notify_all();
+    return NANOARROW_OK;
+  }
 };
 
-class SimpleCsvArrayBuilder {
+static SimpleCsvArrayReader* SimpleCsvMakeReader(
+    const std::string& filename, const SimpleCsvOptions& options,
+    std::shared_ptr<SimpleCsvSharedState> shared);
+
+// Returns the number of rows in a file as a single batch with one int64 column
+// named "count". Without a filter the rows are never split into fields or
+// appended to Arrow buffers: the scanner counts the newlines outside of quoted
+// fields. With a filter the rows have to be parsed to evaluate it, so the
+// batches of a regular scan are counted instead. Without a filter, the file's
+// index has the count, and a count that has to scan the file builds the index
+// if options.index is set.
+class SimpleCsvCountReader : public SimpleCsvArrayReader {
  public:
-  SimpleCsvArrayBuilder(const std::string& filename) : scanner_(filename) {
+  SimpleCsvCountReader(const std::string& filename, const SimpleCsvOptions& options,
+                       std::shared_ptr<SimpleCsvSharedState> shared)
+      : filename_(filename),
+        options_(options),
+        shared_(std::move(shared)),
+        done_(false) {
     ArrowErrorSet(&last_error_, "Internal error");
   }
 
-  int GetSchema(ArrowSchema* out) {
-    NANOARROW_RETURN_NOT_OK(ReadSchemaIfNeeded());
-    NANOARROW_RETURN_NOT_OK(ArrowSchemaDeepCopy(schema_.get(), out));
+  int GetSchema(ArrowSchema* out) override {
+    nanoarrow::UniqueSchema schema;
+    ArrowSchemaInit(schema.get());
+    NANOARROW_RETURN_NOT_OK(ArrowSchemaSetTypeStruct(schema.get(), 1));
+    NANOARROW_RETURN_NOT_OK(
+        ArrowSchemaSetType(schema->children[0], NANOARROW_TYPE_INT64));
+    NANOARROW_RETURN_NOT_OK(ArrowSchemaSetName(schema->children[0], "count"));
+    ArrowSchemaMove(schema.get(), out);
     return NANOARROW_OK;
   }
 
-  int GetArray(ArrowArray* out) {
-    if (status_ == ScanResult::DONE) {
+  int GetArray(ArrowArray* out) override {
+    if (done_) {
       out->release = nullptr;
       return NANOARROW_OK;
     }
 
-    NANOARROW_RETURN_NOT_OK(ReadSchemaIfNeeded());
-    NANOARROW_RETURN_NOT_OK(InitArrayIfNeeded());
+    SimpleCsvIndex index;
+    if (options_.build_index) {
+      NANOARROW_RETURN_NOT_OK(BuildIndex(&index));
+    }
 
-    while (status_ != ScanResult::DONE) {
-      NANOARROW_RETURN_NOT_OK(ReadLine());
+    int64_t n_rows;
+    if (options_.filter.empty()) {
+      if (options_.build_index) {
+        n_rows = index.n_records;
+      } else {
+        NANOARROW_RETURN_NOT_OK(CountLines(&n_rows));
+      }
+      n_rows = std::max<int64_t>(n_rows - options_.offset, 0);
+      if (options_.limit >= 0) {
+        n_rows = std::min(n_rows, options_.limit);
+      }
+    } else {
+      NANOARROW_RETURN_NOT_OK(CountFilteredRows(&n_rows));
     }
 
-    NANOARROW_RETURN_NOT_OK(ArrowArrayFinishBuildingDefault(array_.get(), &last_error_));
-    ArrowArrayMove(array_.get(), out);
+    nanoarrow::UniqueSchema schema;
+    NANOARROW_RETURN_NOT_OK(GetSchema(schema.get()));
+    nanoarrow::UniqueArray array;
+    NANOARROW_RETURN_NOT_OK(
+        ArrowArrayInitFromSchema(array.get(), schema.get(), &last_error_));
+    NANOARROW_RETURN_NOT_OK(ArrowArrayStartAppending(array.get()));
+    NANOARROW_RETURN_NOT_OK(ArrowArrayAppendInt(array->children[0], n_rows));
+    NANOARROW_RETURN_NOT_OK(ArrowArrayFinishElement(array.get()));
+    NANOARROW_RETURN_NOT_OK(ArrowArrayFinishBuildingDefault(array.get(), &last_error_));
+    array.move(out);
+    done_ = true;
     return NANOARROW_OK;
   }
 
-  const char* GetLastError() { return last_error_.message; }
+  const char* GetLastError() override { return last_error_.message; }
 
  private:
-  ScanResult status_;
-  SimpleCsvScanner scanner_;
-  std::vector<std::string> fields_;
+  std::string filename_;
+  SimpleCsvOptions options_;
+  std::shared_ptr<SimpleCsvSharedState> shared_;
+  bool done_;
   ArrowError last_error_;
-  nanoarrow::UniqueSchema schema_;
-  nanoarrow::UniqueArray array_;
 
-  int ReadSchemaIfNeeded() {
-    if (schema_->release != nullptr) {
+  int CountLines(int64_t* n_rows) {
+    SimpleCsvIndex index;
+    if (SimpleCsvLoadIndex(filename_, options_, &index) ||
+        (options_.index && BuildIndex(&index) == NANOARROW_OK)) {
+      *n_rows = index.n_records;
       return NANOARROW_OK;
     }
 
-    fields_.clear();
-    status_ = scanner_.ReadLine(&fields_);
+    SimpleCsvScanner scanner(
+        SimpleCsvMakeInput(filename_, 0, options_, shared_.get()), 0);
+    std::vector<ArrowStringView> header;
+    ScanResult status;
+    NANOARROW_RETURN_NOT_OK(scanner.ReadLine(&header, &status, &last_error_));
+    if (status == ScanResult::DONE) {
+      *n_rows = 0;
+      return NANOARROW_OK;
+    }
 
-    ArrowSchemaInit(schema_.get());
-    NANOARROW_RETURN_NOT_OK(ArrowSchemaSetTypeStruct(schema_.get(), fields_.size()));
-    for (int64_t i = 0; i < schema_->n_children; i++) {
-      NANOARROW_RETURN_NOT_OK(
-          ArrowSchemaSetType(schema_->children[i], NANOARROW_TYPE_STRING));
+    return scanner.CountLines(n_rows, &last_error_);
+  }
+
+  // Indexes the file by skipping index_interval records at a time, and writes
+  // the index
+  int BuildIndex(SimpleCsvIndex* index) {
+    NANOARROW_RETURN_NOT_OK(
+        SimpleCsvFileIdentity(filename_, &index->identity, &last_error_));
+    index->interval = options_.index_interval;
+
+    SimpleCsvScanner scanner(
+        SimpleCsvMakeInput(filename_, 0, options_, shared_.get()), 0);
+    std::vector<ArrowStringView> header;
+    ScanResult status;
+    NANOARROW_RETURN_NOT_OK(scanner.ReadLine(&header, &status, &last_error_));
+    index->data_start = scanner.position();
+    while (status != ScanResult::DONE) {
+      int64_t position = scanner.position();
+      int64_t skipped;
       NANOARROW_RETURN_NOT_OK(
-          ArrowSchemaSetName(schema_->children[i], fields_[i].c_str()));
+          scanner.SkipLines(index->interval, &skipped, &status, &last_error_));
+      if (skipped > 0) {
+        index->offsets.push_back(position);
+        index->n_records += skipped;
+      }
     }
 
-    return NANOARROW_OK;
+    return SimpleCsvWriteIndex(SimpleCsvIndexPath(filename_, options_.sidecar_dir),
+                               *index, &last_error_);
   }
 
-  int InitArrayIfNeeded() {
-    if (array_->release != nullptr) {
+  int CountFilteredRows(int64_t* n_rows) {
+    SimpleCsvOptions options = options_;
+    options.count_only = false;
+    options.build_index = false;
+    std::unique_ptr<SimpleCsvArrayReader> reader(
+        SimpleCsvMakeReader(filename_, options, shared_));
+
+    *n_rows = 0;
+    while (true) {
+      nanoarrow::UniqueArray batch;
+      int code = reader->GetArray(batch.get());
+      if (code != NANOARROW_OK) {
+        ArrowErrorSet(&last_error_, "%s", reader->GetLastError());
+        return code;
+      }
+
+      if (batch->release == nullptr) {
+        return NANOARROW_OK;
+      }
+
+      *n_rows += batch->length;
+    }
+  }
+};
+
+// Passes through the batches of another reader while keeping them for the
+// database's result cache. Each batch is exported from a SimpleCsvSharedBatch
+// so that the consumer and the cache share its buffers. Once the batches
+// exceed the budget, or if the read fails, nothing is cached.
+class SimpleCsvCachingReader : public SimpleCsvArrayReader {
+ public:
+  SimpleCsvCachingReader(std::unique_ptr<SimpleCsvArrayReader> reader,
+                         std::shared_ptr<SimpleCsvSharedState> shared, std::string key,
+                         std::string identity, int64_t budget_bytes)
+      : reader_(std::move(reader)),
+        shared_(std::move(shared)),
+        key_(std::move(key)),
+        identity_(std::move(identity)),
+        budget_bytes_(budget_bytes),
+        result_(new SimpleCsvCachedResult()) {}
+
+  int GetSchema(ArrowSchema* out) override { return reader_->GetSchema(out); }
+
+  int GetArray(ArrowArray* out) override {
+    if (!result_) {
+      return reader_->GetArray(out);
+    }
+
+    if (result_->schema->release == nullptr &&
+        reader_->GetSchema(result_->schema.get()) != NANOARROW_OK) {
+      result_.reset();
+      return reader_->GetArray(out);
+    }
+
+    nanoarrow::UniqueArray array;
+    int code = reader_->GetArray(array.get());
+    if (code != NANOARROW_OK) {
+      result_.reset();
+      return code;
+    }
+
+    if (array->release == nullptr) {
+      shared_->results().Put(key_, identity_, std::move(result_), budget_bytes_);
+      result_.reset();
+      out->release = nullptr;
       return NANOARROW_OK;
     }
 
-    NANOARROW_RETURN_NOT_OK(
-        ArrowArrayInitFromSchema(array_.get(), schema_.get(), &last_error_));
-    NANOARROW_RETURN_NOT_OK(ArrowArrayStartAppending(array_.get()));
+    auto batch =
+        std::make_shared<SimpleCsvSharedBatch>(array.get(), result_->schema.get());
+    SimpleCsvSharedBatch::Export(batch, out);
+    result_->size_bytes += batch->size_bytes();
+    if (result_->size_bytes > budget_bytes_) {
+      result_.reset();
+    } else {
+      result_->batches.push_back(std::move(batch));
+    }
+
     return NANOARROW_OK;
   }
 
-  int ReadLine() {
-    fields_.clear();
-    status_ = scanner_.ReadLine(&fields_);
+  const char* GetLastError() override { return reader_->GetLastError(); }
 
-    // Skip blank line
-    if (fields_.size() == 1 && fields_[0] == "") {
+ private:
+  std::unique_ptr<SimpleCsvArrayReader> reader_;
+  std::shared_ptr<SimpleCsvSharedState> shared_;
+  std::string key_;
+  std::string identity_;
+  int64_t budget_bytes_;
+  std::shared_ptr<SimpleCsvCachedResult> result_;
+};
+
+// Passes through the batches of another reader while writing them to a
+// sidecar. A sidecar is best effort: if it can't be written, the read goes on
+// without it.
+class SimpleCsvSidecarWritingReader : public SimpleCsvArrayReader {
+ public:
+  SimpleCsvSidecarWritingReader(std::unique_ptr<SimpleCsvArrayReader> reader,
+                                std::unique_ptr<SimpleCsvSidecarWriter> writer)
+      : reader_(std::move(reader)), writer_(std::move(writer)), opened_(false) {}
+
+  int GetSchema(ArrowSchema* out) override { return reader_->GetSchema(out); }
+
+  int GetArray(ArrowArray* out) override {
+    if (writer_ && !opened_) {
+      nanoarrow::UniqueSchema schema;
+      if (reader_->GetSchema(schema.get()) != NANOARROW_OK ||
+          writer_->Open(schema.get(), &writer_error_) != NANOARROW_OK) {
+        writer_.reset();
+      }
+      opened_ = true;
+    }
+
+    NANOARROW_RETURN_NOT_OK(reader_->GetArray(out));
+    if (!writer_) {
       return NANOARROW_OK;
     }
 
-    if (schema_->n_children != fields_.size()) {
-      ArrowErrorSet(&last_error_, "Expected %ld fields but found %ld fields",
-                    (long)schema_->n_children, (long)fields_.size());
-      return EINVAL;
+    int code;
+    if (out->release == nullptr) {
+      code = writer_->Finish(&writer_error_);
+    } else {
+      code = writer_->Write(out, &writer_error_);
+    }
+    if (code != NANOARROW_OK || out->release == nullptr) {
+      writer_.reset();
     }
 
-    ArrowStringView view;
-    for (int64_t i = 0; i < schema_->n_children; i++) {
-      view.data = fields_[i].data();
-      view.size_bytes = fields_[i].size();
-      NANOARROW_RETURN_NOT_OK(ArrowArrayAppendString(array_->children[i], view));
+    return NANOARROW_OK;
+  }
+
+  const char* GetLastError() override { return reader_->GetLastError(); }
+
+ private:
+  std::unique_ptr<SimpleCsvArrayReader> reader_;
+  std::unique_ptr<SimpleCsvSidecarWriter> writer_;
+  bool opened_;
+  ArrowError writer_error_;
+};
+
+// Returns the batches of a cached result without copying their buffers
+class SimpleCsvCachedReader : public SimpleCsvArrayReader {
+ public:
+  explicit SimpleCsvCachedReader(std::shared_ptr<SimpleCsvCachedResult> result)
+      : result_(std::move(result)), next_batch_(0) {
+    ArrowErrorSet(&last_error_, "Internal error");
+  }
+
+  int GetSchema(ArrowSchema* out) override {
+    return ArrowSchemaDeepCopy(result_->schema.get(), out);
+  }
+
+  int GetArray(ArrowArray* out) override {
+    if (next_batch_ == result_->batches.size()) {
+      out->release = nullptr;
+      return NANOARROW_OK;
     }
 
-    NANOARROW_RETURN_NOT_OK(ArrowArrayFinishElement(array_.get()));
+    SimpleCsvSharedBatch::Export(result_->batches[next_batch_++], out);
     return NANOARROW_OK;
   }
+
+  const char* GetLastError() override { return last_error_.message; }
+
+ private:
+  std::shared_ptr<SimpleCsvCachedResult> result_;
+  size_t next_batch_;
+  ArrowError last_error_;
 };
 
+constexpr int64_t SimpleCsvScanner::kLineStartLookahead;
+constexpr int64_t SimpleCsvDictionaryEncoder::kInitialSlots;
+constexpr int64_t SimpleCsvArrayBuilder::kReserveRows;
+constexpr int64_t SimpleCsvArrayBuilder::kFilterGroupRows;
+constexpr int64_t SimpleCsvArrayBuilder::kFilterGroupBytes;
+constexpr int64_t SimpleCsvArrayBuilder::kMaxOffset;
+constexpr int64_t SimpleCsvParallelReader::kMinChunkSize;
+constexpr int64_t SimpleCsvParallelReader::kMaxChunkSize;
+
 static int SimpleCsvArrayStreamGetSchema(ArrowArrayStream* stream, ArrowSchema* out) {
-  auto private_data = reinterpret_cast<SimpleCsvArrayBuilder*>(stream->private_data);
+  auto private_data = reinterpret_cast<SimpleCsvArrayReader*>(stream->private_data);
   return private_data->GetSchema(out);
 }
 
 static int SimpleCsvArrayStreamGetNext(ArrowArrayStream* stream, ArrowArray* out) {
-  auto private_data = reinterpret_cast<SimpleCsvArrayBuilder*>(stream->private_data);
+  auto private_data = reinterpret_cast<SimpleCsvArrayReader*>(stream->private_data);
   return private_data->GetArray(out);
 }
 
 static const char* SimpleCsvArrayStreamGetLastError(ArrowArrayStream* stream) {
-  auto private_data = reinterpret_cast<SimpleCsvArrayBuilder*>(stream->private_data);
+  auto private_data = reinterpret_cast<SimpleCsvArrayReader*>(stream->private_data);
   return private_data->GetLastError();
 }
 
 static void SimpleCsvArrayStreamRelease(ArrowArrayStream* stream) {
-  auto private_data = reinterpret_cast<SimpleCsvArrayBuilder*>(stream->private_data);
+  auto private_data = reinterpret_cast<SimpleCsvArrayReader*>(stream->private_data);
   delete private_data;
   stream->release = nullptr;
 }
 
-void InitSimpleCsvArrayStream(const char* filename, ArrowArrayStream* out) {
+static SimpleCsvArrayReader* SimpleCsvMakeUncachedReader(
+    const std::string& filename, const SimpleCsvOptions& options,
+    std::shared_ptr<SimpleCsvSharedState> shared) {
+  if (options.count_only || options.build_index) {
+    return new SimpleCsvCountReader(filename, options, std::move(shared));
+  }
+
+  // A limit or offset is a preview of the start of the file, which is read
+  // on one thread so that the scan can stop as soon as the limit is reached.
+  // Compressed files can only be decompressed from the start, so they are
+  // also parsed on one thread.
+  if (options.threads > 1 && options.limit < 0 && options.offset == 0 &&
+      options.compression == SimpleCsvCompression::NONE) {
+    return new SimpleCsvParallelReader(filename, options, std::move(shared));
+  } else {
+    return SimpleCsvMakeIndexedBuilder(filename, options, shared.get()).release();
+  }
+}
+
+// The key of a read in the result cache of a SimpleCsvSharedState: the key of
+// the file's schema and the options that decide which rows are returned and
+// how they are divided into batches. A parallel read also ends a batch at the
+// end of each chunk, and the number of threads and the file's index decide
+// where those are.
+static std::string SimpleCsvResultCacheKey(const std::string& filename,
+                                           const SimpleCsvOptions& options) {
+  std::string key = SimpleCsvSchemaCacheKey(filename, options);
+  key += std::to_string(options.batch_size_rows);
+  key.push_back('\0');
+  key += std::to_string(options.threads);
+  key.push_back('\0');
+  key += std::to_string(options.index);
+  key.push_back('\0');
+  key += std::to_string(options.limit);
+  key.push_back('\0');
+  key += std::to_string(options.offset);
+  key.push_back('\0');
+  key += std::to_string(options.count_only);
+  return key;
+}
+
+// Returns the cached result of the same read of this version of the file if
+// there is one, in memory or in a sidecar, and otherwise a reader that caches
+// its result
+static SimpleCsvArrayReader* SimpleCsvMakeReader(
+    const std::string& filename, const SimpleCsvOptions& options,
+    std::shared_ptr<SimpleCsvSharedState> shared) {
+  // Building an index has to scan the file
+  bool use_cache = options.cache_bytes > 0 && shared && !options.build_index;
+  // Sidecars hold whole files, which most reads with a limit or offset are not
+  bool use_sidecar = options.sidecar && options.limit < 0 && options.offset == 0 &&
+                     !options.count_only && !options.build_index;
+  std::string identity;
+  ArrowError error;
+  if ((!use_cache && !use_sidecar) ||
+      SimpleCsvFileIdentity(filename, &identity, &error) != NANOARROW_OK) {
+    return SimpleCsvMakeUncachedReader(filename, options, std::move(shared));
+  }
+
+  std::string key = SimpleCsvResultCacheKey(filename, options);
+  std::shared_ptr<SimpleCsvCachedResult> result;
+  if (use_cache) {
+    result = shared->results().Get(key, identity);
+    if (result) {
+      return new SimpleCsvCachedReader(std::move(result));
+    }
+  }
+
+  std::unique_ptr<SimpleCsvArrayReader> reader;
+  if (use_sidecar) {
+    std::string path = SimpleCsvSidecarPath(filename, options.sidecar_dir, key, ".scsv");
+    if (SimpleCsvReadSidecar(path, key, identity, &result, &error) == NANOARROW_OK) {
+      if (use_cache) {
+        shared->results().Put(key, identity, result, options.cache_bytes);
+      }
+      return new SimpleCsvCachedReader(std::move(result));
+    }
+
+    // A missing or stale sidecar is written again
+    std::unique_ptr<SimpleCsvSidecarWriter> writer(
+        new SimpleCsvSidecarWriter(path, key, identity));
+    reader.reset(new SimpleCsvSidecarWritingReader(
+        std::unique_ptr<SimpleCsvArrayReader>(
+            SimpleCsvMakeUncachedReader(filename, options, shared)),
+        std::move(writer)));
+  } else {
+    reader.reset(SimpleCsvMakeUncachedReader(filename, options, shared));
+  }
+
+  if (!use_cache) {
+    return reader.release();
+  }
+
+  return new SimpleCsvCachingReader(std::move(reader), std::move(shared), std::move(key),
+                                    std::move(identity), options.cache_bytes);
+}
+
+// The options for reading a partition: those of the partition that decide the
+// rows and columns it returns, and otherwise those of the reader
+static SimpleCsvOptions SimpleCsvPartitionOptions(const SimpleCsvPartition& partition,
+                                                  const SimpleCsvOptions& options) {
+  SimpleCsvOptions out = options;
+  out.columns = partition.projection;
+  out.null_values = partition.null_values;
+  out.filter = partition.filter;
+  out.limit = partition.limit;
+  out.offset = partition.offset;
+  out.count_only = false;
+  out.compression = SimpleCsvDetectCompression(partition.filename);
+  return out;
+}
+
+// Reads one partition with a SimpleCsvArrayBuilder over its byte range, after
+// checking that the file is still the one it was planned from
+class SimpleCsvPartitionReader : public SimpleCsvArrayReader {
+ public:
+  SimpleCsvPartitionReader(const SimpleCsvPartition& partition,
+                           const SimpleCsvOptions& options,
+                           std::shared_ptr<SimpleCsvSharedState> shared)
+      : partition_(partition),
+        options_(SimpleCsvPartitionOptions(partition, options)),
+        shared_(std::move(shared)),
+        initialized_(false),
+        code_(NANOARROW_OK) {
+    ArrowErrorSet(&last_error_, "Internal error");
+  }
+
+  int GetSchema(ArrowSchema* out) override {
+    NANOARROW_RETURN_NOT_OK(InitIfNeeded());
+    return builder_->GetSchema(out);
+  }
+
+  int GetArray(ArrowArray* out) override {
+    NANOARROW_RETURN_NOT_OK(InitIfNeeded());
+    return builder_->GetArray(out);
+  }
+
+  const char* GetLastError() override {
+    return builder_ != nullptr ? builder_->GetLastError() : last_error_.message;
+  }
+
+ private:
+  SimpleCsvPartition partition_;
+  SimpleCsvOptions options_;
+  std::shared_ptr<SimpleCsvSharedState> shared_;
+  bool initialized_;
+  int code_;
+  ArrowError last_error_;
+  std::unique_ptr<SimpleCsvArrayBuilder> builder_;
+
+  int InitIfNeeded() {
+    if (!initialized_) {
+      initialized_ = true;
+      code_ = Init();
+    }
+
+    return code_;
+  }
+
+  int Init() {
+    const std::string& filename = partition_.filename;
+    int64_t file_size;
+    NANOARROW_RETURN_NOT_OK(SimpleCsvFileSize(filename, &file_size, &last_error_));
+    std::string identity;
+    if (!partition_.identity.empty()) {
+      NANOARROW_RETURN_NOT_OK(SimpleCsvFileIdentity(filename, &identity, &last_error_));
+    }
+
+    // The header has to have the partition's column names
+    SimpleCsvScanner header(SimpleCsvMakeInput(filename, 0, options_, shared_.get()), 0);
+    std::vector<ArrowStringView> fields;
+    ScanResult status = ScanResult::UNINITIALIZED;
+    NANOARROW_RETURN_NOT_OK(header.ReadLine(&fields, &status, &last_error_));
+    bool same_columns = fields.size() == partition_.columns.size();
+    for (size_t i = 0; same_columns && i < fields.size(); i++) {
+      same_columns = partition_.columns[i].name ==
+                     std::string(fields[i].data, fields[i].size_bytes);
+    }
+
+    if (file_size != partition_.file_size || identity != partition_.identity ||
+        !same_columns) {
+      ArrowErrorSet(&last_error_, "'%s' has changed since it was partitioned",
+                    filename.c_str());
+      return EINVAL;
+    }
+
+    nanoarrow::UniqueSchema schema;
+    ArrowSchemaInit(schema.get());
+    NANOARROW_RETURN_NOT_OK(
+        ArrowSchemaSetTypeStruct(schema.get(), partition_.columns.size()));
+    for (size_t i = 0; i < partition_.columns.size(); i++) {
+      const SimpleCsvPartitionColumn& column = partition_.columns[i];
+      NANOARROW_RETURN_NOT_OK(SimpleCsvSetColumnType(schema->children[i], column.type,
+                                                     column.large_string));
+      NANOARROW_RETURN_NOT_OK(
+          ArrowSchemaSetName(schema->children[i], column.name.c_str()));
+    }
+
+    builder_.reset(new SimpleCsvArrayBuilder(filename, options_, shared_.get(),
+                                             schema.get(), partition_.begin,
+                                             partition_.end));
+    return NANOARROW_OK;
+  }
+};
+
+std::shared_ptr<SimpleCsvUring> SimpleCsvSharedState::GetUring() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!uring_initialized_) {
+    uring_ = SimpleCsvUring::Make();
+    uring_initialized_ = true;
+  }
+
+  return uring_;
+}
+
+bool SimpleCsvSharedState::GetSchema(const std::string& key, const std::string& identity,
+                                     ArrowSchema* schema, int64_t* data_start) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto cached = schemas_.find(key);
+  if (cached == schemas_.end() || cached->second.identity != identity ||
+      ArrowSchemaDeepCopy(cached->second.schema.get(), schema) != NANOARROW_OK) {
+    return false;
+  }
+
+  *data_start = cached->second.data_start;
+  return true;
+}
+
+void SimpleCsvSharedState::PutSchema(const std::string& key, const std::string& identity,
+                                     ArrowSchema* schema, int64_t data_start) {
+  nanoarrow::UniqueSchema copy;
+  if (ArrowSchemaDeepCopy(schema, copy.get()) != NANOARROW_OK) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  CachedSchema& cached = schemas_[key];
+  cached.identity = identity;
+  cached.schema.reset(copy.get());
+  cached.data_start = data_start;
+}
+
+// The options for a stream that reads filename, which include its compression
+static SimpleCsvOptions SimpleCsvStreamOptions(const char* filename,
+                                               const SimpleCsvOptions& options) {
+  SimpleCsvOptions out = options;
+  out.compression = SimpleCsvDetectCompression(filename);
+  return out;
+}
+
+void InitSimpleCsvArrayStream(const char* filename, const SimpleCsvOptions& options,
+                              std::shared_ptr<SimpleCsvSharedState> shared,
+                              ArrowArrayStream* out) {
+  out->get_schema = &SimpleCsvArrayStreamGetSchema;
+  out->get_next = &SimpleCsvArrayStreamGetNext;
+  out->get_last_error = &SimpleCsvArrayStreamGetLastError;
+  out->release = &SimpleCsvArrayStreamRelease;
+  out->private_data = SimpleCsvMakeReader(
+      filename, SimpleCsvStreamOptions(filename, options), std::move(shared));
+}
+
+int SimpleCsvPlanPartitions(const char* filename, const SimpleCsvOptions& read_options,
+                            std::shared_ptr<SimpleCsvSharedState> shared,
+                            ArrowSchema* schema, std::vector<SimpleCsvPartition>* out,
+                            ArrowError* error) {
+  SimpleCsvOptions options = SimpleCsvStreamOptions(filename, read_options);
+  if (options.count_only) {
+    ArrowErrorSet(error, "count_only can't be used with partitions");
+    return EINVAL;
+  }
+
+  // Read the header to get the schema and where the data starts
+  std::unique_ptr<SimpleCsvArrayBuilder> header =
+      SimpleCsvMakeBuilder(filename, options, shared.get());
+  nanoarrow::UniqueSchema file_schema;
+  int code = header->GetSchema(schema);
+  if (code == NANOARROW_OK) {
+    code = header->GetFileSchema(file_schema.get());
+  }
+  if (code != NANOARROW_OK) {
+    ArrowErrorSet(error, "%s", header->GetLastError());
+    return code;
+  }
+
+  SimpleCsvPartition partition;
+  partition.filename = filename;
+  NANOARROW_RETURN_NOT_OK(SimpleCsvFileSize(filename, &partition.file_size, error));
+  ArrowError identity_error;
+  if (SimpleCsvFileIdentity(filename, &partition.identity, &identity_error) !=
+      NANOARROW_OK) {
+    partition.identity.clear();
+  }
+  for (int64_t i = 0; i < file_schema->n_children; i++) {
+    ArrowSchema* child = file_schema->children[i];
+    SimpleCsvPartitionColumn column;
+    column.name = child->name;
+    NANOARROW_RETURN_NOT_OK(SimpleCsvGetColumnType(child, &column.type, error));
+    ArrowSchemaView schema_view;
+    NANOARROW_RETURN_NOT_OK(ArrowSchemaViewInit(&schema_view, child, error));
+    column.large_string = schema_view.type == NANOARROW_TYPE_LARGE_STRING;
+    partition.columns.push_back(column);
+  }
+  partition.fingerprint = partition.ComputeFingerprint();
+  partition.projection = options.columns;
+  partition.null_values = options.null_values;
+  partition.filter = options.filter;
+  partition.limit = options.limit;
+  partition.offset = options.offset;
+
+  // Find the start of the first record at or after each multiple of the
+  // partition size by following the newlines outside of quoted fields
+  int64_t data_start = header->position();
+  partition.begin = data_start;
+  partition.end = partition.file_size;
+  bool compressed = options.compression != SimpleCsvCompression::NONE;
+  if (compressed) {
+    partition.end = std::numeric_limits<int64_t>::max();
+  }
+
+  out->clear();
+  if (header->finished() || compressed || options.limit >= 0 || options.offset > 0 ||
+      options.partition_size_bytes <= 0) {
+    out->push_back(partition);
+    return NANOARROW_OK;
+  }
+
+  // With an index, partitions start at indexed records without a scan
+  SimpleCsvIndex index;
+  if (SimpleCsvLoadIndex(filename, options, &index) && index.data_start == data_start) {
+    for (int64_t offset : index.offsets) {
+      if (offset >= partition.begin + options.partition_size_bytes &&
+          offset < partition.file_size) {
+        SimpleCsvPartition next = partition;
+        partition.end = next.begin = offset;
+        out->push_back(partition);
+        partition = next;
+      }
+    }
+
+    partition.end = partition.file_size;
+    out->push_back(partition);
+    return NANOARROW_OK;
+  }
+
+  SimpleCsvScanner scanner(
+      SimpleCsvMakeInput(filename, data_start, options, shared.get()), data_start);
+  ScanResult status = ScanResult::UNINITIALIZED;
+  while (status != ScanResult::DONE) {
+    int64_t target = partition.begin + options.partition_size_bytes;
+    if (target >= partition.file_size) {
+      break;
+    }
+
+    NANOARROW_RETURN_NOT_OK(scanner.SkipTo(target, &status, error));
+    if (scanner.position() >= partition.file_size) {
+      break;
+    }
+
+    SimpleCsvPartition next = partition;
+    partition.end = next.begin = scanner.position();
+    out->push_back(partition);
+    partition = next;
+  }
+
+  partition.end = partition.file_size;
+  out->push_back(partition);
+  return NANOARROW_OK;
+}
+
+int64_t SimpleCsvIndexedRowCount(const char* filename, const SimpleCsvOptions& options) {
+  SimpleCsvIndex index;
+  if (!options.filter.empty() || !SimpleCsvLoadIndex(filename, options, &index)) {
+    return -1;
+  }
+
+  int64_t n_rows = std::max<int64_t>(index.n_records - options.offset, 0);
+  if (options.limit >= 0) {
+    n_rows = std::min(n_rows, options.limit);
+  }
+  return n_rows;
+}
+
+void InitSimpleCsvPartitionStream(const SimpleCsvPartition& partition,
+                                  const SimpleCsvOptions& options,
+                                  std::shared_ptr<SimpleCsvSharedState> shared,
+                                  ArrowArrayStream* out) {
   out->get_schema = &SimpleCsvArrayStreamGetSchema;
   out->get_next = &SimpleCsvArrayStreamGetNext;
   out->get_last_error = &SimpleCsvArrayStreamGetLastError;
   out->release = &SimpleCsvArrayStreamRelease;
-  out->private_data = new SimpleCsvArrayBuilder(filename);
+  out->private_data = new SimpleCsvPartitionReader(partition, options, std::move(shared));
 }
@@ -1,4 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "adbc.h"
+#include "nanoarrow.hpp"
+#include "simple_csv_cache.h"
+#include "simple_csv_decompress.h"
+
+class SimpleCsvUring;
+struct SimpleCsvPartition;
+
+enum class SimpleCsvInputMode { BUFFERED, MMAP, READAHEAD, IO_URING };
+
+// Whether STRING columns are returned as large_string (with int64 offsets)
+// rather than string. AUTO chooses large_string only when a batch's values
+// could pass the 2 GiB that int32 offsets can address.
+enum class SimpleCsvLargeString { AUTO, ALWAYS, NEVER };
+
+// The types a column can be read as. DICTIONARY columns hold strings encoded as
+// int32 indices into a dictionary of the distinct values in each batch.
+enum class SimpleCsvColumnType {
+  STRING,
+  INT64,
+  DOUBLE,
+  BOOL,
+  DATE32,
+  TIMESTAMP,
+  DICTIONARY
+};
+
+// The names of column types used in options and messages ("int64", etc.)
+const char* SimpleCsvColumnTypeName(SimpleCsvColumnType type);
+bool SimpleCsvColumnTypeFromName(const std::string& name, SimpleCsvColumnType* out);
+
+// Options that control how a file is read. These are set from database and
+// statement options by the driver.
+struct SimpleCsvOptions {
+  SimpleCsvInputMode input_mode = SimpleCsvInputMode::BUFFERED;
+  // The number of blocks a READAHEAD or IO_URING input may read ahead of the
+  // parser, including the one it is parsing. At least 2.
+  int64_t readahead_blocks = 4;
+  // Each batch returned by get_next() ends once it has this many rows or its
+  // buffers hold approximately this many bytes. Zero means no limit.
+  int64_t batch_size_rows = 65536;
+  int64_t batch_size_bytes = 64 * 1024 * 1024;
+  // A batch also ends early if the values of a string column would no longer
+  // fit its int32 offsets, so this only decides the type of STRING columns
+  SimpleCsvLargeString large_string = SimpleCsvLargeString::AUTO;
+  // Number of threads used to parse the file. With more than one thread the
+  // file is split into byte ranges that are parsed concurrently.
+  int64_t threads = 1;
+  // The approximate size of each partition made by SimpleCsvPlanPartitions()
+  int64_t partition_size_bytes = 64 * 1024 * 1024;
+  // Guess the type of each column from the first infer_rows rows. Otherwise
+  // (or if the rows give no evidence) a column is read as strings.
+  bool infer_types = true;
+  int64_t infer_rows = 10000;
+  // Infer DICTIONARY rather than STRING for columns with at most
+  // dictionary_max_values distinct values in the rows used to infer types
+  bool dictionary = false;
+  int64_t dictionary_max_values = 1000;
+  // Types given explicitly for columns by name, which take precedence over
+  // inferred types
+  std::vector<std::pair<std::string, SimpleCsvColumnType>> column_types;
+  // The names of the columns to return, in order. Empty means all of them.
+  std::vector<std::string> columns;
+  // Unquoted field values that are read as null in every column
+  std::vector<std::string> null_values = {"", "NA", "NULL", "\\N"};
+  // The number of rows to return after skipping the first offset rows.
+  // Negative means all of them.
+  int64_t limit = -1;
+  int64_t offset = 0;
+  // Only rows that pass this expression are returned (see SimpleCsvFilter).
+  // Empty means all of them.
+  std::string filter;
+  // Return the number of rows (after the filter, offset and limit) instead of
+  // their values
+  bool count_only = false;
+  // Keep the batches of completed reads in the database's result cache, which
+  // holds up to this many bytes. Zero disables the cache.
+  int64_t cache_bytes = 0;
+  // Write the batches of each completed read of a whole file to a sidecar file
+  // (see simple_csv_sidecar.h) that later reads map instead of parsing the file.
+  // Sidecars are kept next to the file, or in sidecar_dir if it isn't empty.
+  bool sidecar = false;
+  std::string sidecar_dir;
+  // Use the index of a file (see simple_csv_index.h), kept next to it or in
+  // sidecar_dir, to count its rows, skip to an offset and choose where to split
+  // it into partitions or chunks. Reads of a whole file without an index build
+  // one as they go.
+  bool index = false;
+  // The number of records between the positions kept in an index
+  int64_t index_interval = 16384;
+  // Scan the file to build its index, then return the number of rows like
+  // count_only
+  bool build_index = false;
+
+  // The compression of the file being read. This isn't set by the driver: it
+  // is detected once when a stream is opened and passed on with the options to
+  // everything that reads the file.
+  SimpleCsvCompression compression = SimpleCsvCompression::NONE;
+};
+
+// State shared by all the streams opened from the same database
+class SimpleCsvSharedState {
+ public:
+  // Returns the io_uring instance that IO_URING inputs submit their reads to,
+  // creating it on first use, or nullptr if io_uring is unavailable
+  std::shared_ptr<SimpleCsvUring> GetUring();
+
+  // Copies the schema cached for key into schema, along with the position of
+  // the first record after the header, if it was read from the version of the
+  // file given by identity (see SimpleCsvFileIdentity())
+  bool GetSchema(const std::string& key, const std::string& identity,
+                 ArrowSchema* schema, int64_t* data_start);
+
+  // Caches the schema read from a file's header for key, which identifies the
+  // file and the options that decide its schema. This replaces the schema
+  // cached for another version of the file.
+  void PutSchema(const std::string& key, const std::string& identity,
+                 ArrowSchema* schema, int64_t data_start);
+
+  // The batches of completed reads (see SimpleCsvOptions::cache_bytes)
+  SimpleCsvResultCache& results() { return results_; }
+
+ private:
+  struct CachedSchema {
+    std::string identity;
+    nanoarrow::UniqueSchema schema;
+    int64_t data_start;
+  };
+
+  std::mutex mutex_;
+  bool uring_initialized_ = false;
+  std::shared_ptr<SimpleCsvUring> uring_;
+  std::unordered_map<std::string, CachedSchema> schemas_;
+  SimpleCsvResultCache results_;
+};
+
+void InitSimpleCsvArrayStream(const char* filename, const SimpleCsvOptions& options,
+                              std::shared_ptr<SimpleCsvSharedState> shared,
+                              ArrowArrayStream* out);
+
+// The number of rows that reading the file with these options returns (or, for
+// count_only and build_index, counts) if it is known without a scan (e.g., from
+// the file's index), or -1
+int64_t SimpleCsvIndexedRowCount(const char* filename, const SimpleCsvOptions& options);
+
+// Splits a file into partitions of about options.partition_size_bytes that
+// each start at the beginning of a record (an indexed one if the file has an
+// index), and returns the schema that reading any of them gives. A file that
+// can't be split (e.g., a compressed one) or a read with a limit or offset,
+// which depend on the order of the rows, is one partition.
+int SimpleCsvPlanPartitions(const char* filename, const SimpleCsvOptions& options,
+                            std::shared_ptr<SimpleCsvSharedState> shared,
+                            ArrowSchema* schema, std::vector<SimpleCsvPartition>* out,
+                            ArrowError* error);
 
-void InitSimpleCsvArrayStream(const char* filename, ArrowArrayStream* out);
+// Reads the rows of one partition using the input and batch options of options
+void InitSimpleCsvPartitionStream(const SimpleCsvPartition& partition,
+                                  const SimpleCsvOptions& options,
+                                  std::shared_ptr<SimpleCsvSharedState> shared,
+                                  ArrowArrayStream* out);
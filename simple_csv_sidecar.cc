@@ -0,0 +1,610 @@
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "simple_csv_sidecar.h"
+
+static const char kSimpleCsvSidecarMagic[] = "SCSVSIDE";
+static constexpr int64_t kSimpleCsvSidecarMagicSize = 8;
+static constexpr int64_t kSimpleCsvSidecarVersion = 1;
+// Written after the version to detect a sidecar from a machine with another
+// byte order
+static constexpr int64_t kSimpleCsvSidecarByteOrder = 0x0102030405060708;
+static constexpr int64_t kSimpleCsvSidecarHeaderSize = 24;
+// The position of the footer followed by the magic string
+static constexpr int64_t kSimpleCsvSidecarTrailerSize = 16;
+static constexpr int64_t kSimpleCsvSidecarAlignment = 64;
+
+class SimpleCsvSidecarEncoder {
+ public:
+  explicit SimpleCsvSidecarEncoder(std::string* out) : out_(out) {}
+
+  void Int(int64_t value) {
+    out_->append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void String(const char* data, int64_t size) {
+    Int(size);
+    out_->append(data, size);
+  }
+
+  void String(const std::string& value) { String(value.data(), value.size()); }
+
+  void Schema(const ArrowSchema* schema) {
+    String(schema->format);
+    Int(schema->name != nullptr);
+    String(schema->name != nullptr ? schema->name : "");
+    Int(schema->metadata != nullptr);
+    if (schema->metadata != nullptr) {
+      String(schema->metadata, ArrowMetadataSizeOf(schema->metadata));
+    }
+    Int(schema->flags);
+    Int(schema->n_children);
+    for (int64_t i = 0; i < schema->n_children; i++) {
+      Schema(schema->children[i]);
+    }
+    Int(schema->dictionary != nullptr);
+    if (schema->dictionary != nullptr) {
+      Schema(schema->dictionary);
+    }
+  }
+
+ private:
+  std::string* out_;
+};
+
+// Maps a whole file into memory read-only
+class SimpleCsvMappedFile {
+ public:
+  SimpleCsvMappedFile() : data_(nullptr), size_(0) {}
+  ~SimpleCsvMappedFile();
+
+  int Open(const std::string& path, ArrowError* error);
+  const uint8_t* data() const { return data_; }
+  int64_t size() const { return size_; }
+
+ private:
+  uint8_t* data_;
+  int64_t size_;
+};
+
+#if defined(_WIN32)
+
+SimpleCsvMappedFile::~SimpleCsvMappedFile() {}
+
+int SimpleCsvMappedFile::Open(const std::string& path, ArrowError* error) {
+  ArrowErrorSet(error, "Sidecar files are not supported on this platform");
+  return ENOTSUP;
+}
+
+#else
+
+SimpleCsvMappedFile::~SimpleCsvMappedFile() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+}
+
+int SimpleCsvMappedFile::Open(const std::string& path, ArrowError* error) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    int code = errno;
+    ArrowErrorSet(error, "Failed to open '%s': %s", path.c_str(), strerror(code));
+    return code;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int code = errno;
+    close(fd);
+    ArrowErrorSet(error, "Failed to stat '%s': %s", path.c_str(), strerror(code));
+    return code;
+  }
+
+  if (st.st_size < kSimpleCsvSidecarHeaderSize + kSimpleCsvSidecarTrailerSize) {
+    close(fd);
+    ArrowErrorSet(error, "Invalid sidecar '%s'", path.c_str());
+    return EINVAL;
+  }
+
+  void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    int code = errno;
+    close(fd);
+    ArrowErrorSet(error, "Failed to map '%s': %s", path.c_str(), strerror(code));
+    return code;
+  }
+
+  // The mapping keeps the file referenced, even after it is replaced
+  close(fd);
+  data_ = static_cast<uint8_t*>(addr);
+  size_ = st.st_size;
+  return NANOARROW_OK;
+}
+
+#endif
+
+// The private data of an array whose buffers point into a sidecar
+struct SimpleCsvSidecarArray {
+  std::shared_ptr<SimpleCsvMappedFile> file;
+  const void* buffers[3];
+  // The size of each buffer as written to the sidecar
+  int64_t sizes[3];
+  std::vector<ArrowArray> children;
+  std::vector<ArrowArray*> child_pointers;
+  ArrowArray dictionary;
+};
+
+static void SimpleCsvSidecarArrayRelease(ArrowArray* array) {
+  auto private_data = reinterpret_cast<SimpleCsvSidecarArray*>(array->private_data);
+  for (ArrowArray* child : private_data->child_pointers) {
+    if (child->release != nullptr) {
+      child->release(child);
+    }
+  }
+  if (private_data->dictionary.release != nullptr) {
+    private_data->dictionary.release(&private_data->dictionary);
+  }
+
+  delete private_data;
+  array->release = nullptr;
+}
+
+// Reads the footer of a sidecar, checking that every buffer is inside the data
+// before the footer
+class SimpleCsvSidecarParser {
+ public:
+  SimpleCsvSidecarParser(std::shared_ptr<SimpleCsvMappedFile> file, int64_t begin,
+                         int64_t end)
+      : file_(std::move(file)), pos_(begin), end_(end), data_end_(begin) {}
+
+  bool Int(int64_t* out) {
+    if (end_ - pos_ < static_cast<int64_t>(sizeof(int64_t))) {
+      return false;
+    }
+
+    memcpy(out, file_->data() + pos_, sizeof(int64_t));
+    pos_ += sizeof(int64_t);
+    return true;
+  }
+
+  bool String(std::string* out) {
+    int64_t size;
+    if (!Int(&size) || size < 0 || size > end_ - pos_) {
+      return false;
+    }
+
+    out->assign(reinterpret_cast<const char*>(file_->data() + pos_), size);
+    pos_ += size;
+    return true;
+  }
+
+  bool Schema(ArrowSchema* out) {
+    ArrowSchemaInit(out);
+    std::string format, name, metadata;
+    int64_t has_name, has_metadata, flags, n_children, has_dictionary;
+    if (!String(&format) || !Int(&has_name) || !String(&name) || !Int(&has_metadata) ||
+        (has_metadata && !String(&metadata)) || !Int(&flags) || !Int(&n_children) ||
+        n_children < 0 || n_children > end_ - pos_) {
+      return false;
+    }
+
+    out->flags = flags;
+    if (ArrowSchemaSetFormat(out, format.c_str()) != NANOARROW_OK ||
+        (has_name && ArrowSchemaSetName(out, name.c_str()) != NANOARROW_OK) ||
+        (has_metadata && ArrowSchemaSetMetadata(out, metadata.data()) != NANOARROW_OK) ||
+        ArrowSchemaAllocateChildren(out, n_children) != NANOARROW_OK) {
+      return false;
+    }
+
+    for (int64_t i = 0; i < n_children; i++) {
+      if (!Schema(out->children[i])) {
+        return false;
+      }
+    }
+
+    if (!Int(&has_dictionary)) {
+      return false;
+    }
+
+    return !has_dictionary || (ArrowSchemaAllocateDictionary(out) == NANOARROW_OK &&
+                               Schema(out->dictionary));
+  }
+
+  // Adds the size of the array's buffers to *size_bytes
+  bool Array(ArrowArray* out, int64_t* size_bytes) {
+    auto private_data = new SimpleCsvSidecarArray();
+    private_data->file = file_;
+    memset(&private_data->dictionary, 0, sizeof(ArrowArray));
+    memset(out, 0, sizeof(ArrowArray));
+    out->buffers = private_data->buffers;
+    out->release = &SimpleCsvSidecarArrayRelease;
+    out->private_data = private_data;
+
+    int64_t n_children, has_dictionary;
+    if (!Int(&out->length) || !Int(&out->null_count) || !Int(&out->offset) ||
+        !Int(&out->n_buffers) || out->n_buffers < 0 || out->n_buffers > 3) {
+      return false;
+    }
+
+    for (int64_t i = 0; i < out->n_buffers; i++) {
+      int64_t position, size;
+      if (!Int(&position) || !Int(&size)) {
+        return false;
+      }
+
+      if (position == -1) {
+        private_data->buffers[i] = nullptr;
+        private_data->sizes[i] = 0;
+      } else if (position >= kSimpleCsvSidecarHeaderSize && size >= 0 &&
+                 position <= data_end_ && size <= data_end_ - position) {
+        private_data->buffers[i] = file_->data() + position;
+        private_data->sizes[i] = size;
+        *size_bytes += size;
+      } else {
+        return false;
+      }
+    }
+
+    if (!Int(&n_children) || n_children < 0 || n_children > end_ - pos_) {
+      return false;
+    }
+
+    private_data->children.resize(n_children);
+    private_data->child_pointers.resize(n_children);
+    for (int64_t i = 0; i < n_children; i++) {
+      private_data->children[i].release = nullptr;
+      private_data->child_pointers[i] = &private_data->children[i];
+    }
+    out->n_children = n_children;
+    out->children = n_children > 0 ? private_data->child_pointers.data() : nullptr;
+
+    for (int64_t i = 0; i < n_children; i++) {
+      if (!Array(&private_data->children[i], size_bytes)) {
+        return false;
+      }
+    }
+
+    if (!Int(&has_dictionary)) {
+      return false;
+    }
+
+    if (has_dictionary) {
+      out->dictionary = &private_data->dictionary;
+      return Array(&private_data->dictionary, size_bytes);
+    }
+
+    return true;
+  }
+
+  bool finished() const { return pos_ == end_; }
+
+ private:
+  std::shared_ptr<SimpleCsvMappedFile> file_;
+  int64_t pos_;
+  int64_t end_;
+  int64_t data_end_;
+};
+
+// Points view at an array read from a sidecar. Unlike ArrowArrayViewSetArray(),
+// which works out the size of each buffer from the array's length and offsets,
+// this uses the sizes written to the sidecar, so checking the array with
+// ArrowArrayViewValidate() never reads past the end of a buffer.
+static int SimpleCsvSidecarSetView(ArrowArrayView* view, ArrowArray* array,
+                                   ArrowError* error) {
+  int64_t n_buffers = 0;
+  while (n_buffers < 3 &&
+         view->layout.buffer_type[n_buffers] != NANOARROW_BUFFER_TYPE_NONE) {
+    n_buffers++;
+  }
+
+  if (array->length < 0 || array->offset < 0 || array->n_buffers != n_buffers ||
+      array->n_children != view->n_children ||
+      (array->dictionary == nullptr) != (view->dictionary == nullptr)) {
+    ArrowErrorSet(error, "Array doesn't match the schema");
+    return EINVAL;
+  }
+
+  auto private_data = reinterpret_cast<SimpleCsvSidecarArray*>(array->private_data);
+  view->array = array;
+  view->offset = array->offset;
+  view->length = array->length;
+  view->null_count = array->null_count;
+  for (int64_t i = 0; i < n_buffers; i++) {
+    view->buffer_views[i].data.data = private_data->buffers[i];
+    view->buffer_views[i].size_bytes = private_data->sizes[i];
+  }
+
+  for (int64_t i = 0; i < array->n_children; i++) {
+    NANOARROW_RETURN_NOT_OK(
+        SimpleCsvSidecarSetView(view->children[i], array->children[i], error));
+  }
+
+  if (array->dictionary != nullptr) {
+    NANOARROW_RETURN_NOT_OK(
+        SimpleCsvSidecarSetView(view->dictionary, array->dictionary, error));
+  }
+
+  return NANOARROW_OK;
+}
+
+// Checks what ArrowArrayViewValidate() leaves out: that offsets never decrease,
+// so that every value is inside the data buffer, and that dictionary indices
+// are inside the dictionary
+static int SimpleCsvSidecarCheckValues(ArrowArrayView* view, ArrowError* error) {
+  int64_t end = view->offset + view->length;
+  for (int i = 0; i < 3; i++) {
+    if (view->layout.buffer_type[i] != NANOARROW_BUFFER_TYPE_DATA_OFFSET ||
+        view->buffer_views[i].size_bytes == 0) {
+      continue;
+    }
+
+    ArrowBufferView offsets = view->buffer_views[i];
+    for (int64_t j = view->offset; j < end; j++) {
+      bool decreasing = view->layout.element_size_bits[i] == 32
+                            ? offsets.data.as_int32[j + 1] < offsets.data.as_int32[j]
+                            : offsets.data.as_int64[j + 1] < offsets.data.as_int64[j];
+      if (decreasing) {
+        ArrowErrorSet(error, "Offsets decrease at element %ld", (long)j);
+        return EINVAL;
+      }
+    }
+  }
+
+  if (view->dictionary != nullptr) {
+    for (int64_t j = 0; j < view->length; j++) {
+      if (ArrowArrayViewIsNull(view, j)) {
+        continue;
+      }
+
+      int64_t index = ArrowArrayViewGetIntUnsafe(view, j);
+      if (index < 0 || index >= view->dictionary->length) {
+        ArrowErrorSet(error, "Dictionary index %ld is out of range", (long)index);
+        return EINVAL;
+      }
+    }
+    NANOARROW_RETURN_NOT_OK(SimpleCsvSidecarCheckValues(view->dictionary, error));
+  }
+
+  for (int64_t i = 0; i < view->n_children; i++) {
+    NANOARROW_RETURN_NOT_OK(SimpleCsvSidecarCheckValues(view->children[i], error));
+  }
+
+  return NANOARROW_OK;
+}
+
+std::string SimpleCsvSidecarPath(const std::string& filename, const std::string& dir,
+                                 const std::string& key, const char* extension) {
+  // FNV-1a over the key, which includes the path of the file
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : key) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ULL;
+  }
+
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%016" PRIx64, hash);
+
+  size_t slash = filename.find_last_of("/\\");
+  std::string basename =
+      slash == std::string::npos ? filename : filename.substr(slash + 1);
+  if (dir.empty()) {
+    return filename + suffix + extension;
+  } else {
+    return dir + "/" + basename + suffix + extension;
+  }
+}
+
+int SimpleCsvReadSidecar(const std::string& path, const std::string& key,
+                         const std::string& identity,
+                         std::shared_ptr<SimpleCsvCachedResult>* out, ArrowError* error) {
+  auto file = std::make_shared<SimpleCsvMappedFile>();
+  NANOARROW_RETURN_NOT_OK(file->Open(path, error));
+
+  const uint8_t* data = file->data();
+  int64_t size = file->size();
+  int64_t version, byte_order, footer;
+  memcpy(&version, data + kSimpleCsvSidecarMagicSize, sizeof(int64_t));
+  memcpy(&byte_order, data + 2 * kSimpleCsvSidecarMagicSize, sizeof(int64_t));
+  memcpy(&footer, data + size - kSimpleCsvSidecarTrailerSize, sizeof(int64_t));
+  if (memcmp(data, kSimpleCsvSidecarMagic, kSimpleCsvSidecarMagicSize) != 0 ||
+      memcmp(data + size - kSimpleCsvSidecarMagicSize, kSimpleCsvSidecarMagic,
+             kSimpleCsvSidecarMagicSize) != 0 ||
+      version != kSimpleCsvSidecarVersion || byte_order != kSimpleCsvSidecarByteOrder ||
+      footer < kSimpleCsvSidecarHeaderSize ||
+      footer > size - kSimpleCsvSidecarTrailerSize) {
+    ArrowErrorSet(error, "Invalid sidecar '%s'", path.c_str());
+    return EINVAL;
+  }
+
+  SimpleCsvSidecarParser parser(file, footer, size - kSimpleCsvSidecarTrailerSize);
+  std::string sidecar_key, sidecar_identity;
+  if (!parser.String(&sidecar_key) || !parser.String(&sidecar_identity)) {
+    ArrowErrorSet(error, "Invalid sidecar '%s'", path.c_str());
+    return EINVAL;
+  }
+
+  if (sidecar_key != key || sidecar_identity != identity) {
+    ArrowErrorSet(error, "Sidecar '%s' is for another version of the file", path.c_str());
+    return EINVAL;
+  }
+
+  auto result = std::make_shared<SimpleCsvCachedResult>();
+  int64_t n_batches;
+  bool ok = parser.Schema(result->schema.get()) && parser.Int(&n_batches) &&
+            n_batches >= 0;
+  for (int64_t i = 0; ok && i < n_batches; i++) {
+    nanoarrow::UniqueArray array;
+    int64_t size_bytes = 0;
+    ok = parser.Array(array.get(), &size_bytes);
+    if (!ok) {
+      break;
+    }
+
+    // The buffers are only known to be inside the file, so check that they
+    // are big enough for the array's length and offsets before handing it out
+    nanoarrow::UniqueArrayView view;
+    ArrowError batch_error;
+    if (ArrowArrayViewInitFromSchema(view.get(), result->schema.get(), &batch_error) !=
+            NANOARROW_OK ||
+        SimpleCsvSidecarSetView(view.get(), array.get(), &batch_error) != NANOARROW_OK ||
+        ArrowArrayViewValidate(view.get(), NANOARROW_VALIDATION_LEVEL_DEFAULT,
+                               &batch_error) != NANOARROW_OK ||
+        SimpleCsvSidecarCheckValues(view.get(), &batch_error) != NANOARROW_OK) {
+      ArrowErrorSet(error, "Invalid sidecar '%s': batch %ld: %s", path.c_str(), (long)i,
+                    batch_error.message);
+      return EINVAL;
+    }
+
+    result->batches.push_back(
+        std::make_shared<SimpleCsvSharedBatch>(array.get(), size_bytes));
+    result->size_bytes += size_bytes;
+  }
+
+  if (!ok || !parser.finished()) {
+    ArrowErrorSet(error, "Invalid sidecar '%s'", path.c_str());
+    return EINVAL;
+  }
+
+  *out = std::move(result);
+  return NANOARROW_OK;
+}
+
+SimpleCsvSidecarWriter::SimpleCsvSidecarWriter(const std::string& path,
+                                               const std::string& key,
+                                               const std::string& identity)
+    : path_(path),
+      key_(key),
+      identity_(identity),
+      position_(0),
+      n_batches_(0),
+      finished_(false) {
+  // Streams writing the same sidecar each write their own temporary file
+  std::random_device random;
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", random(), random());
+  temp_path_ = path_ + suffix;
+}
+
+SimpleCsvSidecarWriter::~SimpleCsvSidecarWriter() {
+  if (output_.is_open()) {
+    output_.close();
+  }
+  if (!finished_ && schema_->release != nullptr) {
+    std::remove(temp_path_.c_str());
+  }
+}
+
+int SimpleCsvSidecarWriter::Open(ArrowSchema* schema, ArrowError* error) {
+  NANOARROW_RETURN_NOT_OK(ArrowSchemaDeepCopy(schema, schema_.get()));
+  output_.open(temp_path_, std::ios::binary | std::ios::trunc);
+  if (!output_.is_open()) {
+    ArrowErrorSet(error, "Failed to create '%s'", temp_path_.c_str());
+    return EIO;
+  }
+
+  std::string header(kSimpleCsvSidecarMagic, kSimpleCsvSidecarMagicSize);
+  SimpleCsvSidecarEncoder encoder(&header);
+  encoder.Int(kSimpleCsvSidecarVersion);
+  encoder.Int(kSimpleCsvSidecarByteOrder);
+  output_.write(header.data(), header.size());
+  position_ = header.size();
+  return NANOARROW_OK;
+}
+
+int SimpleCsvSidecarWriter::Write(ArrowArray* array, ArrowError* error) {
+  nanoarrow::UniqueArrayView view;
+  NANOARROW_RETURN_NOT_OK(ArrowArrayViewInitFromSchema(view.get(), schema_.get(), error));
+  NANOARROW_RETURN_NOT_OK(ArrowArrayViewSetArray(view.get(), array, error));
+  NANOARROW_RETURN_NOT_OK(WriteArray(view.get(), array, error));
+  n_batches_++;
+
+  if (!output_) {
+    ArrowErrorSet(error, "Failed to write '%s'", temp_path_.c_str());
+    return EIO;
+  }
+
+  return NANOARROW_OK;
+}
+
+int SimpleCsvSidecarWriter::Finish(ArrowError* error) {
+  std::string footer;
+  SimpleCsvSidecarEncoder encoder(&footer);
+  encoder.String(key_);
+  encoder.String(identity_);
+  encoder.Schema(schema_.get());
+  encoder.Int(n_batches_);
+  footer += batches_;
+  encoder.Int(position_);
+  footer.append(kSimpleCsvSidecarMagic, kSimpleCsvSidecarMagicSize);
+
+  output_.write(footer.data(), footer.size());
+  output_.close();
+  if (!output_) {
+    ArrowErrorSet(error, "Failed to write '%s'", temp_path_.c_str());
+    return EIO;
+  }
+
+  if (std::rename(temp_path_.c_str(), path_.c_str()) != 0) {
+    int code = errno;
+    ArrowErrorSet(error, "Failed to rename '%s' to '%s': %s", temp_path_.c_str(),
+                  path_.c_str(), strerror(code));
+    return EIO;
+  }
+
+  finished_ = true;
+  return NANOARROW_OK;
+}
+
+int SimpleCsvSidecarWriter::WriteArray(ArrowArrayView* view, ArrowArray* array,
+                                       ArrowError* error) {
+  SimpleCsvSidecarEncoder encoder(&batches_);
+  encoder.Int(array->length);
+  encoder.Int(array->null_count);
+  encoder.Int(array->offset);
+  encoder.Int(array->n_buffers);
+  for (int64_t i = 0; i < array->n_buffers; i++) {
+    if (array->buffers[i] == nullptr) {
+      encoder.Int(-1);
+      encoder.Int(0);
+      continue;
+    }
+
+    int64_t size = view->buffer_views[i].size_bytes;
+    Pad(kSimpleCsvSidecarAlignment);
+    encoder.Int(position_);
+    encoder.Int(size);
+    output_.write(reinterpret_cast<const char*>(array->buffers[i]), size);
+    position_ += size;
+  }
+
+  encoder.Int(array->n_children);
+  for (int64_t i = 0; i < array->n_children; i++) {
+    NANOARROW_RETURN_NOT_OK(WriteArray(view->children[i], array->children[i], error));
+  }
+
+  encoder.Int(array->dictionary != nullptr);
+  if (array->dictionary != nullptr) {
+    NANOARROW_RETURN_NOT_OK(WriteArray(view->dictionary, array->dictionary, error));
+  }
+
+  return NANOARROW_OK;
+}
+
+void SimpleCsvSidecarWriter::Pad(int64_t alignment) {
+  static const char zeros[kSimpleCsvSidecarAlignment] = {0};
+  int64_t padding = (alignment - position_ % alignment) % alignment;
+  output_.write(zeros, padding);
+  position_ += padding;
+}
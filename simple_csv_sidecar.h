@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "nanoarrow.hpp"
+#include "simple_csv_cache.h"
+
+// Sidecar files hold the batches of a completed read so that a later read of
+// the same version of the file, with the same options, can map them instead of
+// parsing the file again. Each buffer is stored as it is in memory at a 64-byte
+// aligned position, followed by a footer that describes the schema and the
+// buffers of each batch, the key of the read and the identity of the file
+// (see SimpleCsvFileIdentity()). Sidecars are only read on the machine that
+// wrote them, so integers are stored in native byte order.
+
+// The path of a file derived from filename for the given key (e.g., the
+// sidecar of a read, whose key is from SimpleCsvResultCacheKey()): next to the
+// file if dir is empty, and otherwise in dir. The name ends in a hash of the key
+// followed by extension.
+std::string SimpleCsvSidecarPath(const std::string& filename, const std::string& dir,
+                                 const std::string& key, const char* extension);
+
+// Maps a sidecar into memory. The batches of the result point into the
+// mapping, which stays open until they are all released. Returns ENOENT if
+// there is no sidecar, and EINVAL if it is invalid or was written for another
+// key or version of the file.
+int SimpleCsvReadSidecar(const std::string& path, const std::string& key,
+                         const std::string& identity,
+                         std::shared_ptr<SimpleCsvCachedResult>* out, ArrowError* error);
+
+// Writes a sidecar batch by batch. The sidecar is written to a temporary file
+// that replaces the one at path when it is finished, so readers never see a
+// partial sidecar. An unfinished sidecar is removed.
+class SimpleCsvSidecarWriter {
+ public:
+  SimpleCsvSidecarWriter(const std::string& path, const std::string& key,
+                         const std::string& identity);
+  ~SimpleCsvSidecarWriter();
+
+  int Open(ArrowSchema* schema, ArrowError* error);
+  int Write(ArrowArray* array, ArrowError* error);
+  int Finish(ArrowError* error);
+
+ private:
+  std::string path_;
+  std::string temp_path_;
+  std::string key_;
+  std::string identity_;
+  nanoarrow::UniqueSchema schema_;
+  std::ofstream output_;
+  int64_t position_;
+  // The descriptions of the batches written so far
+  std::string batches_;
+  int64_t n_batches_;
+  bool finished_;
+
+  int WriteArray(ArrowArrayView* view, ArrowArray* array, ArrowError* error);
+  void Pad(int64_t alignment);
+};
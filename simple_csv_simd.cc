@@ -0,0 +1,107 @@
+
+#include "simple_csv_simd.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define SIMPLE_CSV_HAVE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+static void ClassifyScalar(const char* data, SimpleCsvStructuralMasks* out) {
+  uint64_t delimiter = 0;
+  uint64_t newline = 0;
+  uint64_t quote = 0;
+  for (int i = 0; i < 64; i++) {
+    uint64_t bit = uint64_t(1) << i;
+    delimiter |= (data[i] == ',') ? bit : 0;
+    newline |= (data[i] == '\n') ? bit : 0;
+    quote |= (data[i] == '"') ? bit : 0;
+  }
+
+  out->delimiter = delimiter;
+  out->newline = newline;
+  out->quote = quote;
+}
+
+#if defined(SIMPLE_CSV_HAVE_X86_DISPATCH)
+
+static inline uint64_t MaskSse2(__m128i a, __m128i b, __m128i c, __m128i d,
+                                __m128i value) {
+  uint64_t m0 = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, value)));
+  uint64_t m1 = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(b, value)));
+  uint64_t m2 = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(c, value)));
+  uint64_t m3 = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(d, value)));
+  return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+
+static void ClassifySse2(const char* data, SimpleCsvStructuralMasks* out) {
+  __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+  __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+  __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32));
+  __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48));
+  out->delimiter = MaskSse2(a, b, c, d, _mm_set1_epi8(','));
+  out->newline = MaskSse2(a, b, c, d, _mm_set1_epi8('\n'));
+  out->quote = MaskSse2(a, b, c, d, _mm_set1_epi8('"'));
+}
+
+__attribute__((target("avx2"))) static inline uint64_t MaskAvx2(__m256i lo, __m256i hi,
+                                                                __m256i value) {
+  uint64_t m0 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, value)));
+  uint64_t m1 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, value)));
+  return m0 | (m1 << 32);
+}
+
+__attribute__((target("avx2"))) static void ClassifyAvx2(const char* data,
+                                                         SimpleCsvStructuralMasks* out) {
+  __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+  __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+  out->delimiter = MaskAvx2(lo, hi, _mm256_set1_epi8(','));
+  out->newline = MaskAvx2(lo, hi, _mm256_set1_epi8('\n'));
+  out->quote = MaskAvx2(lo, hi, _mm256_set1_epi8('"'));
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void ClassifyAvx512(
+    const char* data, SimpleCsvStructuralMasks* out) {
+  __m512i chunk = _mm512_loadu_si512(data);
+  out->delimiter = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8(','));
+  out->newline = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\n'));
+  out->quote = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('"'));
+}
+
+#endif
+
+SimpleCsvSimdLevel SimpleCsvDetectSimdLevel() {
+#if defined(SIMPLE_CSV_HAVE_X86_DISPATCH)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512bw")) {
+    return SimpleCsvSimdLevel::AVX512;
+  } else if (__builtin_cpu_supports("avx2")) {
+    return SimpleCsvSimdLevel::AVX2;
+  } else {
+    // SSE2 is part of the x86-64 baseline
+    return SimpleCsvSimdLevel::SSE2;
+  }
+#else
+  return SimpleCsvSimdLevel::SCALAR;
+#endif
+}
+
+SimpleCsvClassifyFn SimpleCsvClassifierForLevel(SimpleCsvSimdLevel level) {
+  switch (level) {
+#if defined(SIMPLE_CSV_HAVE_X86_DISPATCH)
+    case SimpleCsvSimdLevel::AVX512:
+      return &ClassifyAvx512;
+    case SimpleCsvSimdLevel::AVX2:
+      return &ClassifyAvx2;
+    case SimpleCsvSimdLevel::SSE2:
+      return &ClassifySse2;
+#endif
+    default:
+      return &ClassifyScalar;
+  }
+}
+
+void SimpleCsvClassify(const char* data, SimpleCsvStructuralMasks* out) {
+  static const SimpleCsvClassifyFn classify =
+      SimpleCsvClassifierForLevel(SimpleCsvDetectSimdLevel());
+  classify(data, out);
+}
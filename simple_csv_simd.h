@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Positions of the structural characters in a 64-byte chunk of input: bit i of
+// each mask is set if byte i of the chunk is that character.
+struct SimpleCsvStructuralMasks {
+  uint64_t delimiter;
+  uint64_t newline;
+  uint64_t quote;
+};
+
+enum class SimpleCsvSimdLevel { SCALAR, SSE2, AVX2, AVX512 };
+
+typedef void (*SimpleCsvClassifyFn)(const char* data, SimpleCsvStructuralMasks* out);
+
+// Returns the best instruction set supported by the CPU we are running on.
+SimpleCsvSimdLevel SimpleCsvDetectSimdLevel();
+
+// Returns the classifier for a given level, falling back to the scalar
+// implementation if the level was not compiled in.
+SimpleCsvClassifyFn SimpleCsvClassifierForLevel(SimpleCsvSimdLevel level);
+
+// Classifies the 64 bytes starting at data using the classifier chosen for
+// this CPU on first use.
+void SimpleCsvClassify(const char* data, SimpleCsvStructuralMasks* out);
+
+// Index of the lowest set bit of a nonzero mask
+static inline int SimpleCsvLowestBit(uint64_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
+
+// Index of the highest set bit of a nonzero mask
+static inline int SimpleCsvHighestBit(uint64_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, mask);
+  return static_cast<int>(index);
+#else
+  return 63 - __builtin_clzll(mask);
+#endif
+}
+
+// Number of set bits in a mask
+static inline int SimpleCsvPopcount(uint64_t mask) {
+#if defined(_MSC_VER)
+  return static_cast<int>(__popcnt64(mask));
+#else
+  return __builtin_popcountll(mask);
+#endif
+}
+
+// Computes a mask where bit i is set if an odd number of bits at positions <= i
+// are set in quotes. Applied to a mask of quote characters, this marks the
+// bytes from each opening quote up to (but not including) its closing quote.
+static inline uint64_t SimpleCsvPrefixXor(uint64_t quotes) {
+  quotes ^= quotes << 1;
+  quotes ^= quotes << 2;
+  quotes ^= quotes << 4;
+  quotes ^= quotes << 8;
+  quotes ^= quotes << 16;
+  quotes ^= quotes << 32;
+  return quotes;
+}
@@ -0,0 +1,74 @@
+
+#include <cstdint>
+#include <random>
+
+#include <catch2/catch.hpp>
+
+#include "simple_csv_simd.h"
+
+TEST_CASE("SIMD classifiers agree with the scalar one", "[simd]") {
+  const char alphabet[] = ",\n\"ab\x80\xff";
+  std::mt19937 random(3);
+  char chunk[64];
+  for (int i = 0; i < 20000; i++) {
+    for (char& c : chunk) {
+      c = alphabet[random() % (sizeof(alphabet) - 1)];
+    }
+
+    SimpleCsvStructuralMasks expected;
+    SimpleCsvClassifierForLevel(SimpleCsvSimdLevel::SCALAR)(chunk, &expected);
+    for (SimpleCsvSimdLevel level : {SimpleCsvSimdLevel::SSE2, SimpleCsvSimdLevel::AVX2,
+                                     SimpleCsvSimdLevel::AVX512}) {
+      SimpleCsvStructuralMasks masks;
+      SimpleCsvClassifierForLevel(level)(chunk, &masks);
+      REQUIRE(masks.delimiter == expected.delimiter);
+      REQUIRE(masks.newline == expected.newline);
+      REQUIRE(masks.quote == expected.quote);
+    }
+  }
+}
+
+TEST_CASE("SimpleCsvClassify sets the bit of each structural character", "[simd]") {
+  char chunk[64];
+  for (char& c : chunk) {
+    c = 'x';
+  }
+  chunk[0] = ',';
+  chunk[5] = '"';
+  chunk[31] = '\n';
+  chunk[32] = ',';
+  chunk[63] = '"';
+
+  SimpleCsvStructuralMasks masks;
+  SimpleCsvClassify(chunk, &masks);
+  CHECK(masks.delimiter == ((uint64_t(1) << 0) | (uint64_t(1) << 32)));
+  CHECK(masks.newline == uint64_t(1) << 31);
+  CHECK(masks.quote == ((uint64_t(1) << 5) | (uint64_t(1) << 63)));
+}
+
+TEST_CASE("SimpleCsvPrefixXor marks the bytes inside quotes", "[simd]") {
+  // Quotes at 2 and 5 mark bytes 2 to 4; an unclosed quote at 60 marks the
+  // rest of the chunk
+  uint64_t quotes = (uint64_t(1) << 2) | (uint64_t(1) << 5) | (uint64_t(1) << 60);
+  CHECK(SimpleCsvPrefixXor(quotes) == (uint64_t(0x1C) | (~uint64_t(0) << 60)));
+
+  // An escaped quote ("") closes the field and opens it again
+  quotes = (uint64_t(1) << 1) | (uint64_t(1) << 4) | (uint64_t(1) << 5) |
+           (uint64_t(1) << 9);
+  CHECK(SimpleCsvPrefixXor(quotes) == (uint64_t(0x0E) | uint64_t(0x1E0)));
+
+  CHECK(SimpleCsvPrefixXor(0) == uint64_t(0));
+  CHECK(SimpleCsvPrefixXor(1) == ~uint64_t(0));
+
+  std::mt19937_64 random(7);
+  for (int i = 0; i < 1000; i++) {
+    uint64_t mask = random() & random();
+    uint64_t expected = 0;
+    uint64_t inside = 0;
+    for (int bit = 0; bit < 64; bit++) {
+      inside ^= (mask >> bit) & 1;
+      expected |= inside << bit;
+    }
+    REQUIRE(SimpleCsvPrefixXor(mask) == expected);
+  }
+}
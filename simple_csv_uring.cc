@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SIMPLE_CSV_HAVE_IO_URING
+#endif
+#endif
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(SIMPLE_CSV_HAVE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "simple_csv_uring.h"
+
+#if defined(SIMPLE_CSV_HAVE_IO_URING)
+
+// The memory shared with the kernel
+struct SimpleCsvUring::Ring {
+  int fd = -1;
+  void* sq_ptr = nullptr;
+  size_t sq_size = 0;
+  void* cq_ptr = nullptr;
+  size_t cq_size = 0;
+  io_uring_sqe* sqes = nullptr;
+  size_t sqes_size = 0;
+
+  unsigned entries = 0;
+  unsigned* sq_head = nullptr;
+  unsigned* sq_tail = nullptr;
+  unsigned sq_mask = 0;
+  unsigned* sq_array = nullptr;
+  unsigned* cq_head = nullptr;
+  unsigned* cq_tail = nullptr;
+  unsigned cq_mask = 0;
+  io_uring_cqe* cqes = nullptr;
+
+  ~Ring() {
+    if (sqes != nullptr) munmap(sqes, sqes_size);
+    if (cq_ptr != nullptr && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+    if (sq_ptr != nullptr) munmap(sq_ptr, sq_size);
+    if (fd != -1) close(fd);
+  }
+
+  int Enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(
+        syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+  }
+};
+
+std::shared_ptr<SimpleCsvUring> SimpleCsvUring::Make(int entries) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  std::unique_ptr<Ring> ring(new Ring());
+  ring->fd = fd;
+  ring->entries = params.sq_entries;
+  ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    ring->sq_size = ring->cq_size = std::max(ring->sq_size, ring->cq_size);
+  }
+
+  void* sq_ptr = mmap(nullptr, ring->sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq_ptr == MAP_FAILED) {
+    return nullptr;
+  }
+  ring->sq_ptr = sq_ptr;
+
+  if (single_mmap) {
+    ring->cq_ptr = sq_ptr;
+  } else {
+    void* cq_ptr = mmap(nullptr, ring->cq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ptr == MAP_FAILED) {
+      return nullptr;
+    }
+    ring->cq_ptr = cq_ptr;
+  }
+
+  ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return nullptr;
+  }
+  ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+  char* sq = static_cast<char*>(ring->sq_ptr);
+  ring->sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  ring->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  ring->sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  ring->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+  char* cq = static_cast<char*>(ring->cq_ptr);
+  ring->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  ring->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  ring->cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+  return std::shared_ptr<SimpleCsvUring>(new SimpleCsvUring(std::move(ring)));
+}
+
+SimpleCsvUring::SimpleCsvUring(std::unique_ptr<Ring> ring)
+    : ring_(std::move(ring)), pending_(0), in_flight_(0), reaping_(false), error_(0) {}
+
+SimpleCsvUring::~SimpleCsvUring() {}
+
+void SimpleCsvUring::Submit(SimpleCsvUringRead* read) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // Don't submit more reads than there is room for completions. A read counts
+  // as in flight from when it is queued in the submission ring, so this also
+  // keeps the ring from overwriting entries the kernel hasn't consumed.
+  while (in_flight_ >= ring_->entries) {
+    Reap(&lock);
+  }
+
+  unsigned tail = *ring_->sq_tail;
+  unsigned index = tail & ring_->sq_mask;
+  io_uring_sqe* sqe = ring_->sqes + index;
+  memset(sqe, 0, sizeof(io_uring_sqe));
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = read->fd;
+  sqe->addr = reinterpret_cast<uint64_t>(read->out);
+  sqe->len = static_cast<uint32_t>(read->size);
+  sqe->off = read->offset;
+  sqe->user_data = reinterpret_cast<uint64_t>(read);
+  ring_->sq_array[index] = index;
+
+  read->done = false;
+  __atomic_store_n(ring_->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  pending_++;
+  in_flight_++;
+}
+
+void SimpleCsvUring::Wait(SimpleCsvUringRead* read) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!read->done && error_ == 0) {
+    Reap(&lock);
+  }
+
+  if (!read->done) {
+    read->result = -error_;
+    read->done = true;
+  }
+}
+
+// Submits any pending reads and waits for at least one completion, or waits
+// for the thread that is already doing so
+void SimpleCsvUring::Reap(std::unique_lock<std::mutex>* lock) {
+  if (reaping_) {
+    cv_.wait(*lock);
+    return;
+  }
+
+  reaping_ = true;
+  unsigned to_submit = pending_;
+  pending_ = 0;
+  lock->unlock();
+  int result = ring_->Enter(to_submit, 1, IORING_ENTER_GETEVENTS);
+  int code = errno;
+  lock->lock();
+
+  if (result >= 0 && static_cast<unsigned>(result) < to_submit) {
+    pending_ += to_submit - result;
+  } else if (result < 0) {
+    pending_ += to_submit;
+  }
+
+  unsigned head = *ring_->cq_head;
+  unsigned tail = __atomic_load_n(ring_->cq_tail, __ATOMIC_ACQUIRE);
+  while (head != tail) {
+    io_uring_cqe* cqe = ring_->cqes + (head & ring_->cq_mask);
+    auto completed = reinterpret_cast<SimpleCsvUringRead*>(cqe->user_data);
+    completed->result = cqe->res;
+    completed->done = true;
+    in_flight_--;
+    head++;
+  }
+  __atomic_store_n(ring_->cq_head, head, __ATOMIC_RELEASE);
+
+  reaping_ = false;
+  cv_.notify_all();
+
+  // Errors other than interruptions mean nothing more will complete
+  if (result < 0 && code != EINTR && code != EAGAIN && code != EBUSY) {
+    error_ = code;
+  }
+}
+
+SimpleCsvUringInput::SimpleCsvUringInput(std::shared_ptr<SimpleCsvUring> uring,
+                                         const std::string& filename, int64_t offset,
+                                         int64_t n_blocks, int64_t block_size)
+    : uring_(std::move(uring)),
+      filename_(filename),
+      next_offset_(offset),
+      fd_(-1),
+      started_(false),
+      eof_(false),
+      use_pread_(false),
+      reads_(n_blocks) {
+  for (int64_t i = 0; i < n_blocks; i++) {
+    blocks_.push_back(std::unique_ptr<Block>(new Block(block_size)));
+  }
+}
+
+SimpleCsvUringInput::~SimpleCsvUringInput() {
+  // The kernel may still be writing into the blocks
+  for (size_t i : in_flight_) {
+    if (!use_pread_) {
+      uring_->Wait(&reads_[i]);
+    }
+  }
+
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+int SimpleCsvUringInput::AcquireBlock(Block** block, ArrowError* error) {
+  if (!started_) {
+    fd_ = open(filename_.c_str(), O_RDONLY);
+    if (fd_ == -1) {
+      ArrowErrorSet(error, "Failed to open '%s': %s", filename_.c_str(), strerror(errno));
+      return errno;
+    }
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd_, next_offset_, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    started_ = true;
+    for (size_t i = 0; i < blocks_.size(); i++) {
+      SubmitBlock(i);
+    }
+  }
+
+  if (in_flight_.empty()) {
+    // Blocks are only left unsubmitted after the end of the file; otherwise
+    // the scanner is holding all of them and none can be refilled
+    if (!eof_) {
+      ArrowErrorSet(error, "Reading '%s' with io_uring needs at least two blocks",
+                    filename_.c_str());
+      return EINVAL;
+    }
+
+    *block = nullptr;
+    return NANOARROW_OK;
+  }
+
+  size_t i = in_flight_.front();
+  in_flight_.pop_front();
+  SimpleCsvUringRead* read = &reads_[i];
+  if (use_pread_) {
+    read->result = 0;
+  } else {
+    uring_->Wait(read);
+  }
+
+  if (read->result == -EINVAL || read->result == -EOPNOTSUPP) {
+    // The kernel doesn't know IORING_OP_READ: read this block and all the
+    // others ourselves once the kernel is done with them
+    for (size_t j : in_flight_) {
+      uring_->Wait(&reads_[j]);
+      reads_[j].result = 0;
+    }
+    use_pread_ = true;
+    read->result = 0;
+  } else if (read->result < 0) {
+    int code = static_cast<int>(-read->result);
+    ArrowErrorSet(error, "Failed to read from '%s': %s", filename_.c_str(),
+                  strerror(code));
+    return code;
+  }
+
+  // Short reads are possible (e.g., on a signal), so read the rest of the
+  // block synchronously; the blocks after it are already at the right offsets
+  if (read->result < read->size) {
+    NANOARROW_RETURN_NOT_OK(ReadRemainder(i, error));
+  }
+
+  if (read->result == 0) {
+    eof_ = true;
+    *block = nullptr;
+    return NANOARROW_OK;
+  }
+
+  blocks_[i]->size = read->result;
+  *block = blocks_[i].get();
+  return NANOARROW_OK;
+}
+
+void SimpleCsvUringInput::ReleaseBlock(Block* block) {
+  for (size_t i = 0; i < blocks_.size(); i++) {
+    if (blocks_[i].get() == block) {
+      SubmitBlock(i);
+      return;
+    }
+  }
+}
+
+void SimpleCsvUringInput::SubmitBlock(size_t i) {
+  if (eof_) {
+    return;
+  }
+
+  SimpleCsvUringRead* read = &reads_[i];
+  read->fd = fd_;
+  read->out = blocks_[i]->data();
+  read->size = blocks_[i]->capacity();
+  read->offset = next_offset_;
+  read->done = false;
+  read->result = 0;
+  next_offset_ += read->size;
+
+  if (!use_pread_) {
+    uring_->Submit(read);
+  }
+  in_flight_.push_back(i);
+}
+
+int SimpleCsvUringInput::ReadRemainder(size_t i, ArrowError* error) {
+  SimpleCsvUringRead* read = &reads_[i];
+  while (read->result < read->size) {
+    ssize_t n = pread(fd_, read->out + read->result, read->size - read->result,
+                      read->offset + read->result);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    } else if (n == -1) {
+      ArrowErrorSet(error, "Failed to read from '%s': %s", filename_.c_str(),
+                    strerror(errno));
+      return errno;
+    } else if (n == 0) {
+      // A block that ends early is the end of the file
+      eof_ = true;
+      break;
+    }
+
+    read->result += n;
+  }
+
+  return NANOARROW_OK;
+}
+
+#else
+
+struct SimpleCsvUring::Ring {};
+
+std::shared_ptr<SimpleCsvUring> SimpleCsvUring::Make(int entries) { return nullptr; }
+
+SimpleCsvUring::SimpleCsvUring(std::unique_ptr<Ring> ring)
+    : ring_(std::move(ring)), pending_(0), in_flight_(0), reaping_(false), error_(0) {}
+
+SimpleCsvUring::~SimpleCsvUring() {}
+
+void SimpleCsvUring::Submit(SimpleCsvUringRead* read) {}
+
+void SimpleCsvUring::Wait(SimpleCsvUringRead* read) {}
+
+void SimpleCsvUring::Reap(std::unique_lock<std::mutex>* lock) {}
+
+SimpleCsvUringInput::SimpleCsvUringInput(std::shared_ptr<SimpleCsvUring> uring,
+                                         const std::string& filename, int64_t offset,
+                                         int64_t n_blocks, int64_t block_size)
+    : uring_(std::move(uring)),
+      filename_(filename),
+      next_offset_(offset),
+      fd_(-1),
+      started_(false),
+      eof_(false),
+      use_pread_(false) {}
+
+SimpleCsvUringInput::~SimpleCsvUringInput() {}
+
+int SimpleCsvUringInput::AcquireBlock(Block** block, ArrowError* error) {
+  ArrowErrorSet(error, "io_uring input is not supported on this platform");
+  return ENOTSUP;
+}
+
+void SimpleCsvUringInput::ReleaseBlock(Block* block) {}
+
+void SimpleCsvUringInput::SubmitBlock(size_t i) {}
+
+int SimpleCsvUringInput::ReadRemainder(size_t i, ArrowError* error) { return ENOTSUP; }
+
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "simple_csv_input.h"
+
+// A read of size bytes at offset of fd into out. result is the number of bytes
+// read or -errno once done is set.
+struct SimpleCsvUringRead {
+  int fd;
+  char* out;
+  int64_t size;
+  int64_t offset;
+  bool done;
+  int64_t result;
+};
+
+// An io_uring instance shared by all the inputs opened from a database.
+// Submitted reads are queued in the submission ring and handed to the kernel
+// in one io_uring_enter() call by whichever thread next waits for a result, so
+// reads from concurrent streams are batched together.
+class SimpleCsvUring {
+ public:
+  // Returns nullptr if io_uring is not supported by the platform or kernel
+  static std::shared_ptr<SimpleCsvUring> Make(int entries = 256);
+
+  ~SimpleCsvUring();
+
+  void Submit(SimpleCsvUringRead* read);
+  void Wait(SimpleCsvUringRead* read);
+
+ private:
+  struct Ring;
+
+  std::unique_ptr<Ring> ring_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  // Reads queued in the submission ring that the kernel hasn't seen yet
+  unsigned pending_;
+  // Reads submitted whose completions haven't been reaped
+  unsigned in_flight_;
+  bool reaping_;
+  int error_;
+
+  explicit SimpleCsvUring(std::unique_ptr<Ring> ring);
+  void Reap(std::unique_lock<std::mutex>* lock);
+};
+
+// Keeps several large reads of a file in flight on a shared SimpleCsvUring,
+// resubmitting each block once the scanner is done with it. If the kernel
+// can't do the reads, the remaining blocks are read with pread().
+class SimpleCsvUringInput : public SimpleCsvBlockInput {
+ public:
+  SimpleCsvUringInput(std::shared_ptr<SimpleCsvUring> uring, const std::string& filename,
+                      int64_t offset, int64_t n_blocks,
+                      int64_t block_size = SimpleCsvBufferedInput::kDefaultBlockSize);
+  ~SimpleCsvUringInput() override;
+
+ protected:
+  int AcquireBlock(Block** block, ArrowError* error) override;
+  void ReleaseBlock(Block* block) override;
+
+ private:
+  std::shared_ptr<SimpleCsvUring> uring_;
+  std::string filename_;
+  int64_t next_offset_;
+  int fd_;
+  bool started_;
+  bool eof_;
+  bool use_pread_;
+  std::vector<std::unique_ptr<Block>> blocks_;
+  std::vector<SimpleCsvUringRead> reads_;
+  // Indices of the blocks being read, in file order
+  std::deque<size_t> in_flight_;
+
+  void SubmitBlock(size_t i);
+  int ReadRemainder(size_t i, ArrowError* error);
+};